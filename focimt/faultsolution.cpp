@@ -11,8 +11,10 @@ using namespace Taquart;
 FaultSolution::FaultSolution(void) {
   // Empty constructor
   DLA = 0.0;
-  U_n = 0;
+  Type = Taquart::ftUnknown;
   UERR = 0.0;
+  DCIterations = 0;
+  DCConverged = true;
   T0 = 0.0; /*!< Rupture time in seconds. */
   M0 = 0.0; /*!< Scalar moment tensor value in Nm. */
   MT = 0.0; /*!< Total seismic moment tensor value in Nm. */
@@ -280,14 +282,9 @@ void FaultSolution::Assign(const FaultSolution &Source) {
   QI = Source.QI;
   MAGN = Source.MAGN;
   Type = Source.Type;
-  for (unsigned int i = 0; i < MAXCHANNEL; i++) {
-    U_th[i] = Source.U_th[i];
-    U_measured[i] = Source.U_measured[i];
-  }
-  U_n = Source.U_n;
-  //U_th = Source.U_th;
-  //U_measured = Source.U_measured;
   UERR = Source.UERR;
+  DCIterations = Source.DCIterations;
+  DCConverged = Source.DCConverged;
 }
 
 //---------------------------------------------------------------------------
@@ -296,6 +293,20 @@ FaultSolution & FaultSolution::operator=(const FaultSolution &Source) {
   return *this;
 }
 
+//---------------------------------------------------------------------------
+const char * FaultSolution::TypeName(void) const {
+  switch (Type) {
+    case Taquart::ftNormalFault:
+      return "Normal fault";
+    case Taquart::ftStrikeFault:
+      return "Strike fault";
+    case Taquart::ftReverseFault:
+      return "Reverse fault";
+    default:
+      return "";
+  }
+}
+
 //---------------------------------------------------------------------------
 Taquart::String FaultSolution::SubString(Taquart::String Line, int Start,
     int End) {
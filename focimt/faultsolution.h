@@ -92,14 +92,13 @@ namespace Taquart {
        settings in FOCI, thus you should take it into
        account while comparing the sesimic moment tensor solutions*/
       double MAGN; /*!< Moment magnitude, calculated by the standard relationships. */
-      Taquart::String Type; /*!< Fault type: can be 'Normal fault', 'Reverse fault' or a 'Strike fault' fault. */
+      Taquart::FaultType Type; /*!< Fault type, see TypeName. */
       double Covariance[7][7]; /*!< Covariance matrix.*/
-      //std::vector<double> U_th;
-      //std::vector<double> U_measured;
-      double U_th[MAXCHANNEL];
-      double U_measured[MAXCHANNEL];
-      int U_n;
       double UERR;
+      int DCIterations; /*!< Iterations of the double-couple refinement
+       (0 if there was none). */
+      bool DCConverged; /*!< False if the double-couple refinement did not
+       converge and the initial axes were kept. */
 
       // Public functions
 
@@ -125,6 +124,12 @@ namespace Taquart {
        */
       void Assign(const FaultSolution &Source);
 
+      //! Fault type as text.
+      /*! \return 'Normal fault', 'Reverse fault', 'Strike fault' or an empty
+       *  string if the type has not been determined.
+       */
+      const char * TypeName(void) const;
+
       //! Save seismic moment tensor solution data into INI file.
       /* \param File Pointer to a \a TMemIniFile object to write data to it.
        * \param SectionName Name of the INI file section to write data to it.
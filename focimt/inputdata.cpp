@@ -251,3 +251,71 @@ double Taquart::SMTInputData::GetRuptureTime(void) {
   return RuptureTime;
 }
 
+//============================================================================
+Taquart::SMTInputView::SMTInputView(const SMTInputData &AData) {
+  Data = &AData;
+  Displacement = 0;
+  Active.assign(Data->InputData.size(), true);
+  Index.reserve(Data->InputData.size());
+  Refresh();
+}
+
+//---------------------------------------------------------------------------
+void Taquart::SMTInputView::Refresh(void) {
+  // Index has the capacity of all lines, so it is never reallocated.
+  Index.clear();
+  for (unsigned int i = 0; i < Active.size(); i++) {
+    const Taquart::SMTInputLine &Line = Data->InputData[i];
+    if (Active[i] && Line.PickActive && Line.ChannelActive) Index.push_back(i);
+  }
+}
+
+//---------------------------------------------------------------------------
+void Taquart::SMTInputView::SetActive(unsigned int AIndex, bool AActive)
+    throw (Taquart::TriEOutOfRange) {
+  if (AIndex >= Active.size())
+    throw Taquart::TriEOutOfRange("Index out of range for "
+        "Foci::SMTInputView class member: std::vector<bool> Active");
+  if (Active[AIndex] == AActive) return;
+  Active[AIndex] = AActive;
+  Refresh();
+}
+
+//---------------------------------------------------------------------------
+void Taquart::SMTInputView::SetAllActive(void) {
+  Active.assign(Active.size(), true);
+  Refresh();
+}
+
+//---------------------------------------------------------------------------
+void Taquart::SMTInputView::SetDisplacements(const double * ADisplacement) {
+  Displacement = ADisplacement;
+}
+
+//---------------------------------------------------------------------------
+unsigned int Taquart::SMTInputView::Count(void) const {
+  return Index.size();
+}
+
+//---------------------------------------------------------------------------
+double Taquart::SMTInputView::GetRuptureTime(void) const {
+  return Data->RuptureTime;
+}
+
+//---------------------------------------------------------------------------
+const Taquart::SMTInputLine & Taquart::SMTInputView::Line(
+    unsigned int AIndex) const {
+  return Data->InputData[Index[AIndex]];
+}
+
+//---------------------------------------------------------------------------
+double Taquart::SMTInputView::GetDisplacement(unsigned int AIndex) const {
+  const unsigned int i = Index[AIndex];
+  return Displacement ? Displacement[i] : Data->InputData[i].Displacement;
+}
+
+//---------------------------------------------------------------------------
+unsigned int Taquart::SMTInputView::Source(unsigned int AIndex) const {
+  return Index[AIndex];
+}
+
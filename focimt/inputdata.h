@@ -181,6 +181,7 @@ namespace Taquart {
        */
       double CountRuptureTime(bool &Result);
     private:
+      friend class SMTInputView;
       int Key;
       double MeanDuration;
       double StdDuration;
@@ -190,6 +191,77 @@ namespace Taquart {
       std::vector<Taquart::SMTInputLine> InputData;
     protected:
   };
+
+  //! Channel-masked view of the input data.
+  /*! The view refers to an existing Foci::SMTInputData object, which must
+   *  outlive it, and holds the lines whose PickActive and ChannelActive flags
+   *  are set and which have not been switched off with SetActive. The
+   *  displacements may be replaced by an external array (SetDisplacements).
+   *  Neither operation copies the input data lines, so a single view per
+   *  thread serves all jackknife and noise test runs.
+   *  \ingroup foci
+   */
+  class SMTInputView {
+    public:
+      //! Constructor, all channels of the data are active.
+      /*! \param AData Reference to the input data.
+       */
+      SMTInputView(const SMTInputData &AData);
+
+      //! Switch a channel on or off.
+      /*! \param Index Index of the line in the input data.
+       *  \param Active \p true to include the channel in the view.
+       */
+      void SetActive(unsigned int Index, bool Active) throw (Taquart::TriEOutOfRange);
+
+      //! Switch all channels on.
+      void SetAllActive(void);
+
+      //! Re-read the PickActive and ChannelActive flags of the input data.
+      /*! Must be called after the flags have been changed. The number of
+       *  lines of the input data must not change.
+       */
+      void Refresh(void);
+
+      //! Replace the displacements of the input data.
+      /*! \param ADisplacement Array of displacements [m] indexed like the
+       *  lines of the input data (not only the active ones), or 0 to use the
+       *  displacements of the input data. The array is not copied.
+       */
+      void SetDisplacements(const double * ADisplacement);
+
+      //! Return number of active lines.
+      unsigned int Count(void) const;
+
+      //! Get rupture time.
+      /*! \return Rupture time [seconds]
+       */
+      double GetRuptureTime(void) const;
+
+      //! Get input data line.
+      /*! \param Index Index of the active line.
+       *  \return Reference to the line of the input data. Its displacement
+       *  is not replaced, use GetDisplacement.
+       */
+      const Taquart::SMTInputLine & Line(unsigned int Index) const;
+
+      //! Get displacement (~seismic moment) value.
+      /*! \param Index Index of the active line.
+       *  \return Displacement value.
+       */
+      double GetDisplacement(unsigned int Index) const;
+
+      //! Get index of an active line in the input data.
+      /*! \param Index Index of the active line.
+       *  \return Index of the line in the input data.
+       */
+      unsigned int Source(unsigned int Index) const;
+    private:
+      const SMTInputData * Data;
+      const double * Displacement;
+      std::vector<bool> Active;
+      std::vector<unsigned int> Index; /*!< Indices of the active lines. */
+  };
 }
 
 //---------------------------------------------------------------------------
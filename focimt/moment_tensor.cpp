@@ -2,8 +2,18 @@
 #include <stdlib.h>
 #include <time.h>
 #include <math.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <trilib/string.h>
 #include <trilib/georoutines.h>
 #include <tricairo/tricairo_meca.h>
@@ -12,6 +22,7 @@
 #include "faultsolution.h"
 #include "inputdata.h"
 #include "usmtcore.h"
+#include "resultwriter.h"
 //-----------------------------------------------------------------------------
 
 using namespace std;
@@ -32,6 +43,34 @@ class FaultSolutions {
     Taquart::FaultSolution FullSolution;
     Taquart::FaultSolution TraceNullSolution;
     Taquart::FaultSolution DoubleCoupleSolution;
+    std::vector<double> U_th; // Theoretical amplitudes, only for -d with U.
+
+    // Exchanges the contents without copying the amplitudes.
+    void Swap(FaultSolutions &Other) {
+      std::swap(Type, Other.Type);
+      std::swap(Channel, Other.Channel);
+      std::swap(FullSolution, Other.FullSolution);
+      std::swap(TraceNullSolution, Other.TraceNullSolution);
+      std::swap(DoubleCoupleSolution, Other.DoubleCoupleSolution);
+      U_th.swap(Other.U_th);
+    }
+};
+
+//-----------------------------------------------------------------------------
+// One event of the catalog (-c option).
+class CatalogEvent {
+  public:
+    Taquart::String Name;
+    Taquart::SMTInputData InputData;
+};
+
+//-----------------------------------------------------------------------------
+// Inverted event of the catalog waiting for the writer.
+class CatalogResult {
+  public:
+    Taquart::String Name;
+    int Status; // 0 - inverted, 1 - inversion error, 2 - no station lines.
+    FaultSolutions Solutions;
 };
 
 //-----------------------------------------------------------------------------
@@ -39,6 +78,187 @@ void GenerateBallCairo(Taquart::TriCairo_Meca &Meca,
     std::vector<FaultSolutions> &FSList, Taquart::SMTInputData &InputData,
     Taquart::String Type);
 
+//-----------------------------------------------------------------------------
+// Counter-based random numbers for the amplitude test. Every deviate is a
+// pure function of the seed, the sample number and the channel number, hence
+// the noise applied to a given sample does not depend on the order in which
+// (or the thread by which) the samples are processed.
+uint64_t SplitMix64(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+//-----------------------------------------------------------------------------
+// Returns N(0,1) deviate (Box-Muller) for the given seed, sample and channel.
+double NormalDeviate(uint64_t Seed, uint64_t Sample, uint64_t Channel) {
+  const uint64_t Key = SplitMix64(SplitMix64(Seed) ^ Sample);
+  const uint64_t r1 = SplitMix64(Key ^ (2 * Channel));
+  const uint64_t r2 = SplitMix64(Key ^ (2 * Channel + 1));
+  // Uniform numbers from (0,1] with 53-bit resolution.
+  const double u1 = double((r1 >> 11) + 1) / 9007199254740992.0;
+  const double u2 = double((r2 >> 11) + 1) / 9007199254740992.0;
+  return sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+//-----------------------------------------------------------------------------
+// Reads one station line (id, duration, displacement, azimuth, takeoff,
+// velocity, distance, density) of the input file. Fields which cannot be
+// read keep their previous values.
+bool ReadStation(std::istream &Input, Taquart::SMTInputLine &il) {
+  Input >> il.Id; /*!< Station id number.*/
+  Input >> il.Duration; /*!< Duration of signal [s].*/
+  Input >> il.Displacement; /*!< Displacement [m]. */
+  Input >> il.Azimuth; /*!< Azimuth between station and source [deg]. */
+  Input >> il.TakeOff; /*!< Takeoff angle [deg]. */
+  Input >> il.Velocity; /*!< Average velocity [m/s]. */
+  Input >> il.Distance; /*!< Distance between station and source [m]. */
+  Input >> il.Density; /*!< Density [km/m**3]. */
+
+  il.Name = Taquart::FormatFloat("%02d", il.Id); /*!< Station name.*/
+  il.Component = "ZZ"; //"ZZ";       /*!< Component.*/
+  il.MarkerType = ""; //"p*ons/p*max";      /*!< Type of the marker used.*/
+  il.Start = 0.0; //tstart;;           /*!< Start time [s].*/
+  il.End = il.Duration; //tend;;             /*!< End time [s].*/
+  il.Incidence = 0; //incidence;       /*!< Angle of incidence [deg]. */
+  il.PickActive = true;
+  il.ChannelActive = true;
+  return !Input.fail();
+}
+
+//-----------------------------------------------------------------------------
+// Reads the next event of the catalog. An event starts with a header line
+// '# name' followed by its station lines, blank lines are skipped. Header
+// holds the header of the next event, which is read together with the last
+// station line of the current one. Events without the name are numbered.
+// A header without station lines is returned as an empty event, so that it
+// keeps its number. Returns false at the end of the catalog.
+bool ReadCatalogEvent(std::istream &Catalog, std::string &Header,
+    CatalogEvent &Event, int Number) {
+  Event.Name = Taquart::FormatFloat("%d", Number);
+  Event.InputData.Clear();
+  std::string Line;
+  bool Named = false;
+  while (true) {
+    if (Header.length()) {
+      Line = Header;
+      Header = "";
+    }
+    else if (!std::getline(Catalog, Line))
+      break;
+
+    std::istringstream Stream(Line);
+    std::string Token;
+    if (!(Stream >> Token)) continue; // Blank line.
+    if (Token[0] == '#') {
+      if (Named || Event.InputData.Count()) {
+        Header = Line;
+        break;
+      }
+      Named = true;
+      // The name may follow the hash sign with or without a space.
+      std::string Name = Token.substr(1);
+      if (Name.length() == 0) Stream >> Name;
+      if (Name.length()) Event.Name = Name.c_str();
+      continue;
+    }
+
+    Taquart::SMTInputLine il;
+    std::istringstream Station(Line);
+    if (ReadStation(Station, il))
+      Event.InputData.Add(il);
+    else
+      std::cout << "Invalid station line in event " << Event.Name.c_str()
+          << ": " << Line << std::endl;
+  }
+
+  if (Event.InputData.Count() == 0) return Named;
+  bool Result = false;
+  Event.InputData.CountRuptureTime(Result);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+// Writes one row of the output file, the columns are given by DumpOrder.
+void DumpSolution(std::ostream &OutFile, const Taquart::String &DumpOrder,
+    const Taquart::FaultSolution &Solution, const std::vector<double> &U_th) {
+  for (int i = 1; i <= DumpOrder.Length(); i++) {
+    // M - moment, D - decomposition, A - axis, F - fault planes,
+    // C - moment in CMT convention.
+
+    // Dump moment tensor components.
+    if (DumpOrder[i] == 'M') {
+      OutFile << Solution.M[1][1] << "\t";
+      OutFile << Solution.M[1][2] << "\t";
+      OutFile << Solution.M[1][3] << "\t";
+      OutFile << Solution.M[2][2] << "\t";
+      OutFile << Solution.M[2][3] << "\t";
+      OutFile << Solution.M[3][3] << "\t";
+    }
+
+    // Dump moment tensor components in CMT convention.
+    if (DumpOrder[i] == 'C') {
+      OutFile << Solution.M[3][3] << "\t";
+      OutFile << Solution.M[1][1] << "\t";
+      OutFile << Solution.M[2][2] << "\t";
+      OutFile << Solution.M[1][3] << "\t";
+      OutFile << -Solution.M[2][3] << "\t";
+      OutFile << -Solution.M[1][2] << "\t";
+    }
+
+    if (DumpOrder[i] == 'D') {
+      OutFile << Solution.EXPL << "\t";
+      OutFile << Solution.CLVD << "\t";
+      OutFile << Solution.DBCP << "\t";
+    }
+
+    if (DumpOrder[i] == 'A') {
+      OutFile << Solution.PXTR << "\t";
+      OutFile << Solution.PXPL << "\t";
+      OutFile << Solution.TXTR << "\t";
+      OutFile << Solution.TXPL << "\t";
+      OutFile << Solution.BXTR << "\t";
+      OutFile << Solution.BXPL << "\t";
+    }
+
+    if (DumpOrder[i] == 'F') {
+      OutFile << Solution.FIA << "\t";
+      OutFile << Solution.DLA << "\t";
+      OutFile << Solution.RAKEA << "\t";
+      OutFile << Solution.FIB << "\t";
+      OutFile << Solution.DLB << "\t";
+      OutFile << Solution.RAKEB << "\t";
+    }
+
+    if (DumpOrder[i] == 'W') {
+      OutFile << Solution.M0 << "\t";
+      OutFile << Solution.MT << "\t";
+      OutFile << Solution.ERR << "\t";
+      OutFile << Solution.MAGN << "\t";
+    }
+
+    if (DumpOrder[i] == 'Q') {
+      OutFile << Solution.QI << "\t";
+    }
+
+    if (DumpOrder[i] == 'T') {
+      OutFile << Solution.TypeName() << "\t";
+    }
+
+    if (DumpOrder[i] == 'U') {
+      for (unsigned int r = 0; r < U_th.size(); r++)
+        OutFile << U_th[r] << "\t";
+    }
+
+    if (DumpOrder[i] == 'E') {
+      OutFile << Solution.UERR << "\t";
+    }
+  }
+
+  OutFile << "\n";
+}
+
 //-----------------------------------------------------------------------------
 bool Dispatch(Taquart::String &Input, Taquart::String &Chunk,
     Taquart::String delimiter) {
@@ -57,6 +277,7 @@ int main(int argc, char* argv[]) {
   try {
     Taquart::String FilenameIn;
     Taquart::String FilenameOut;
+    Taquart::String CatalogFile;
     unsigned int N = 14;
 
     Options listOpts;
@@ -77,9 +298,13 @@ int main(int argc, char* argv[]) {
         true);
     listOpts.addOption("n", "norm",
         "Norm type.               \n\n"
-            "    Arguments: [L1|L2] for L1 and L2 norm, respectively. The default option is \n"
-            "    is '-n L2' (faster). When Jacknife method is used the option is ignored and\n"
-            "    L2 norm is used.                                                           \n",
+            "    Arguments: [L1|L1X|L2] for L1 and L2 norm, respectively. L1X solves the    \n"
+            "    full and trace-null L1 problems exactly by linear programming instead of   \n"
+            "    the grid search. The default option is '-n L2' (faster). When Jacknife     \n"
+            "    method is used the option is ignored and L2 norm is used.                  \n"
+            "    LP[/p] and HUBER[/k] use the Lp norm (1<=p<=2, default 1.5) and the Huber  \n"
+            "    norm with the threshold of k robust standard deviations (default 1.345),   \n"
+            "    both solved by iteratively reweighted least squares.                       \n",
         true);
     listOpts.addOption("p", "projection",
         "Projection type.                                     \n\n"
@@ -150,6 +375,86 @@ int main(int argc, char* argv[]) {
             "                                                                               \n",
         true);
     listOpts.addOption("v", "version", "Display version number");
+    listOpts.addOption("J", "threads",
+        "Number of worker threads.                            \n\n"
+            "    Argument: number of threads used by the Jacknife and amplitude tests and   \n"
+            "    by the grid search of the L1 inversion, e.g. -J 4. The value 0 uses all    \n"
+            "    available processors. The default value is 1 (no threading).              \n",
+        true);
+    listOpts.addOption("r", "seed",
+        "Random seed for the amplitude test.                  \n\n"
+            "    Argument: non-negative integer number. The same seed reproduces the same   \n"
+            "    set of noise samples regardless of the number of threads. By default the   \n"
+            "    seed is taken from the system clock.                                       \n",
+        true);
+    listOpts.addOption("x", "compare-l1",
+        "Compare the L1 engines.                              \n\n"
+            "    Solves the full and trace-null L1 problems with the grid search (-n L1) and\n"
+            "    with linear programming (-n L1X) and prints the time and misfit of both.   \n"
+            "    Problems solved by the grid search fallback of L1X are marked.             \n");
+    listOpts.addOption("w", "warm-start",
+        "Warm start of the L1 grid search.                    \n\n"
+            "    Argument: relative tolerance, e.g. -w 1e-6. The search boxes are built     \n"
+            "    around the L2 solution and its standard deviations and each search stops   \n"
+            "    once its box is narrower than the tolerance times the largest moment       \n"
+            "    tensor component (0 runs all levels). The levels and grid points saved are \n"
+            "    printed for the inversion with all stations.                               \n",
+        true);
+    listOpts.addOption("P", "prune",
+        "Branch and bound in the L1 grid search.              \n\n"
+            "    Skips the parts of the full and trace-null grids whose misfit bound exceeds\n"
+            "    the best misfit found so far. The solution does not change, the fraction of\n"
+            "    grid points pruned is printed for the inversion with all stations.         \n");
+    listOpts.addOption("E", "early-exit",
+        "Early exit of the L1 misfit.                         \n\n"
+            "    The misfit of a grid point is summed from the largest amplitudes and       \n"
+            "    abandoned once it exceeds the best misfit. The solution does not change,   \n"
+            "    the mean number of channels visited is printed for the inversion with all  \n"
+            "    stations.                                                                  \n");
+    listOpts.addOption("T", "deadline-ms",
+        "Time budget of a single inversion.                   \n\n"
+            "    Argument: time in milliseconds, e.g. -T 50. When it expires the L1 grid    \n"
+            "    search returns the best solution found so far. The refinement level and    \n"
+            "    the box width reached are printed for the inversion with all stations.     \n",
+        true);
+    listOpts.addOption("e", "closed-eigen",
+        "Closed-form eigenvalues and eigenvectors.            \n\n"
+            "    Uses the trigonometric solution of the characteristic equation instead of  \n"
+            "    its bisection for the eigenvalues of the moment tensors and the cross      \n"
+            "    products of the rows of M-eI for the P, T and B axes.                      \n");
+    listOpts.addOption("B", "eigen-benchmark",
+        "Benchmark of the eigenvalue solvers.                 \n\n"
+            "    Argument: number of random tensors, e.g. -B 100000. Prints the time per    \n"
+            "    call of the bisection and the closed-form solver and the largest relative  \n"
+            "    difference of their eigenvalues, then exits.                               \n",
+        true);
+    listOpts.addOption("L", "dc-lm",
+        "Levenberg-Marquardt double-couple solution.          \n\n"
+            "    Fits the double couple of the L2, Lp and Huber norms to the amplitudes by  \n"
+            "    Levenberg-Marquardt iterations instead of refining the eigenvectors of the \n"
+            "    trace-null solution. The iterations and the convergence are printed for    \n"
+            "    the inversion with all stations.                                           \n");
+    listOpts.addOption("G", "dc-grid",
+        "Strike/dip/rake grid search for the double couple.   \n\n"
+            "    Argument: step[/tolerance], e.g. -G 5/0.05 (5 degrees, 5%). The double     \n"
+            "    couple is the node of the strike, dip and rake grid with the smallest      \n"
+            "    misfit. The optimum and the nodes whose misfit exceeds the optimum by at   \n"
+            "    most the tolerance times the misfit range of the grid (largest minus       \n"
+            "    smallest misfit) are printed and the misfit of all nodes (strike, dip,     \n"
+            "    rake, misfit) is saved to the output-dcgrid.asc file for the inversion with\n"
+            "    all stations. The step must be at least 2 degrees (about 1.5 million       \n"
+            "    nodes).                                                                    \n",
+        true);
+    listOpts.addOption("c", "catalog",
+        "Catalog of events.                                   \n\n"
+            "    Argument: catalog file with many events, e.g. -c catalog.txt. Each event   \n"
+            "    starts with the line '# name' followed by its station lines in the format  \n"
+            "    of the input file, so the -l option is not needed. The events are inverted \n"
+            "    by the worker threads (-J) with the -s, -n, -d and solver options and the  \n"
+            "    rows of all events, preceded by the event name, are written to the output  \n"
+            "    files in the order of the catalog as soon as they are ready. Events        \n"
+            "    without station lines are reported and skipped. No pictures are drawn.     \n",
+        true);
 
     Taquart::String SolutionTypes = "D";
     Taquart::String NormType = "L2";
@@ -159,10 +464,23 @@ int main(int argc, char* argv[]) {
     Taquart::String OutputFileType = "PNG";
     bool JacknifeTest = false;
     bool NoiseTest = false;
+    bool CompareL1 = false;
+    bool WarmStart = false;
+    double WarmTolerance = 0.0;
+    bool Prune = false;
+    bool Abandon = false;
+    double DeadlineMs = 0.0;
+    bool ClosedFormEigen = false;
+    bool LMDoubleCouple = false;
+    double DCGridStep = 0.0;
+    double DCGridTolerance = 0.05;
+    int EigenBenchmark = 0;
     bool DrawFaultOnly = false;
     bool DrawFaultsOnly = false;
     double AmpFactor = 1.0f;
     unsigned int AmplitudeN = 100;
+    int Threads = 1;
+    uint64_t Seed = uint64_t(time(0));
     Taquart::String Temp;
     Taquart::String FaultString;
     if (listOpts.parse(argc, argv))
@@ -236,17 +554,86 @@ int main(int argc, char* argv[]) {
             std::cout << "Rev. 3.0.1, 2014.11.20\n"
                 "(c) 2011-2015 Grzegorz Kwiatek, GPL license applies.\n";
             break;
+          case 14:
+            Threads =
+                Taquart::String(listOpts.getArgs(switchInt).c_str()).Trim().ToInt();
+            break;
+          case 15:
+            Seed = strtoull(listOpts.getArgs(switchInt).c_str(), NULL, 10);
+            break;
+          case 16:
+            CompareL1 = true;
+            break;
+          case 17:
+            WarmStart = true;
+            WarmTolerance =
+                Taquart::String(listOpts.getArgs(switchInt).c_str()).Trim().ToDouble();
+            break;
+          case 18:
+            Prune = true;
+            break;
+          case 19:
+            Abandon = true;
+            break;
+          case 20:
+            DeadlineMs =
+                Taquart::String(listOpts.getArgs(switchInt).c_str()).Trim().ToDouble();
+            break;
+          case 21:
+            ClosedFormEigen = true;
+            break;
+          case 22:
+            EigenBenchmark =
+                Taquart::String(listOpts.getArgs(switchInt).c_str()).Trim().ToInt();
+            break;
+          case 23:
+            LMDoubleCouple = true;
+            break;
+          case 24:
+            Temp = Taquart::String(listOpts.getArgs(switchInt).c_str()).Trim();
+            if (Temp.Pos("/")) {
+              DCGridStep = Temp.SubString(1, Temp.Pos("/") - 1).ToDouble();
+              DCGridTolerance = Temp.SubString(Temp.Pos("/") + 1, 1000).ToDouble();
+            }
+            else
+              DCGridStep = Temp.ToDouble();
+            if (DCGridStep < DCGRID_MIN_STEP || DCGridTolerance < 0.0) {
+              std::cout << "Invalid grid step or tolerance (-G), the step must"
+                  " be at least " << DCGRID_MIN_STEP << " degrees." << std::endl;
+              return 1;
+            }
+            break;
+          case 25:
+            CatalogFile =
+                Taquart::String(listOpts.getArgs(switchInt).c_str()).Trim();
+            break;
         }
       }
 
-    if (FilenameIn.Length() == 0 && DrawFaultOnly == false
-        && DrawFaultsOnly == false) {
+    if (EigenBenchmark > 0) {
+      Taquart::UsmtCore Core;
+      double Time[2 + 1], MaxError = 0.0, MaxTrace = 0.0;
+      Core.BenchmarkEigen(EigenBenchmark, Time, MaxError, MaxTrace);
+      char Line[160];
+      sprintf(Line, "EIG3 bisection:   %10.1f ns per call", Time[1] * 1.0e9);
+      std::cout << Line << std::endl;
+      sprintf(Line, "EIG3 closed form: %10.1f ns per call", Time[2] * 1.0e9);
+      std::cout << Line << std::endl;
+      sprintf(Line, "Largest relative difference %.3e, trace residual %.3e",
+          MaxError, MaxTrace);
+      std::cout << Line << std::endl;
+      return 0;
+    }
+
+    if (FilenameIn.Length() == 0 && CatalogFile.Length() == 0
+        && DrawFaultOnly == false && DrawFaultsOnly == false) {
       std::cout << "You must provide a valid filename." << std::endl;
     }
 
     if (FilenameOut.Length() == 0 && DrawFaultOnly == false
         && DrawFaultsOnly == false) {
-      FilenameOut = Taquart::ExtractFileName(FilenameIn);
+      FilenameOut = Taquart::ExtractFileName(
+          FilenameIn.Length() ? FilenameIn : CatalogFile);
       if (FilenameOut.Pos("."))
         FilenameOut = FilenameOut.SubString(1, FilenameOut.Pos(".") - 1);
     }
@@ -452,53 +839,186 @@ int main(int argc, char* argv[]) {
     }
 
     // Prepare processing structs.
-    Taquart::NormType InversionNormType =
-        (NormType == "L2") ? Taquart::ntL2 : Taquart::ntL1;
+    Taquart::NormType InversionNormType = Taquart::ntL1;
+    double LpExponent = 1.5;
+    double HuberConstant = 1.345;
+    if (NormType.Pos("/")) {
+      Temp = NormType.SubString(NormType.Pos("/") + 1, 1000);
+      NormType = NormType.SubString(1, NormType.Pos("/") - 1);
+      LpExponent = HuberConstant = Temp.ToDouble();
+    }
+    if (NormType == "L2") InversionNormType = Taquart::ntL2;
+    if (NormType == "L1X") InversionNormType = Taquart::ntL1X;
+    if (NormType == "LP") InversionNormType = Taquart::ntLp;
+    if (NormType == "HUBER") InversionNormType = Taquart::ntHuber;
+    const bool L1Norm = (InversionNormType == Taquart::ntL1
+        || InversionNormType == Taquart::ntL1X);
     int QualityType = 1;
+    // Theoretical amplitudes are kept only if they are dumped.
+    const bool DumpAmplitudes = DumpOrder.Pos("U") > 0;
+#ifdef _OPENMP
+    if (Threads <= 0) Threads = omp_get_num_procs();
+#endif
+
+    if (CatalogFile.Length()) {
+      std::ifstream Catalog(CatalogFile.c_str());
+      if (!Catalog) {
+        std::cout << "Cannot open the catalog file." << std::endl;
+        return 1;
+      }
+
+      // The rows of the whole catalog are written in large blocks.
+      Taquart::ResultWriter Results(1 << 20);
+
+      // The catalog is processed in three stages by every thread of the
+      // pool: the reader takes the next event from the file, the worker
+      // inverts it with the solver context of the thread and the writer
+      // dumps all inverted events which are next in the order of the
+      // catalog. The stages of different threads overlap, so reading never
+      // stops the inversion and no thread waits for the slowest event. The
+      // events inverted ahead of a slower predecessor wait in Pending, at
+      // most Window of them: the reader does not run further ahead of the
+      // writer.
+      const int Window = 4 * Threads;
+      std::map<int, CatalogResult> Pending;
+      std::string Header;
+      int Total = 0, Written = 0, Failed = 0, Empty = 0;
+      bool More = true;
+
+      // The events of a catalog are usually recorded by the same network.
+      Taquart::UsmtGeometryCache GeometryCache;
+
+#pragma omp parallel num_threads(Threads)
+      {
+        Taquart::UsmtCore * Core = new Taquart::UsmtCore;
+        Core->L1WarmStart = WarmStart;
+        Core->L1Tolerance = WarmTolerance;
+        Core->L1Prune = Prune;
+        Core->L1Abandon = Abandon;
+        Core->LpExponent = LpExponent;
+        Core->HuberConstant = HuberConstant;
+        Core->DeadlineMs = DeadlineMs;
+        Core->ClosedFormEigen = ClosedFormEigen;
+        Core->LMDoubleCouple = LMDoubleCouple;
+        Core->DCGridStep = DCGridStep;
+        Core->Geometry = &GeometryCache;
+        CatalogEvent Event;
+
+        while (true) {
+          // Reader stage, waits while the window is full.
+          int Number = 0;
+          bool Full = true;
+          while (Full) {
+#pragma omp critical(CatalogReader)
+            {
+              int Done = 0;
+#pragma omp critical(CatalogWriter)
+              Done = Written;
+              Full = More && Total - Done >= Window;
+              if (More && !Full) {
+                More = ReadCatalogEvent(Catalog, Header, Event, Total + 1);
+                if (More) Number = ++Total;
+              }
+            }
+          }
+          if (Number == 0) break;
+
+          // Worker stage.
+          FaultSolutions fs;
+          int Status = 2;
+          if (Event.InputData.Count()) {
+            Status = 0;
+            try {
+              int ThreadProgress = 0;
+              Core->Run(InversionNormType, QualityType, Event.InputData,
+                  &ThreadProgress);
+              Core->TransferSolution(Taquart::stFullSolution,
+                  fs.FullSolution);
+              Core->TransferSolution(Taquart::stTraceNullSolution,
+                  fs.TraceNullSolution);
+              Core->TransferSolution(Taquart::stDoubleCoupleSolution,
+                  fs.DoubleCoupleSolution);
+              if (DumpAmplitudes) Core->TransferAmplitudes(fs.U_th);
+            }
+            catch (...) {
+              Status = 1;
+            }
+          }
+
+          // Writer stage.
+#pragma omp critical(CatalogWriter)
+          {
+            CatalogResult &Result = Pending[Number];
+            Result.Name = Event.Name;
+            Result.Status = Status;
+            Result.Solutions.Swap(fs);
+
+            std::map<int, CatalogResult>::iterator Next = Pending.begin();
+            while (Next != Pending.end() && Next->first == Written + 1) {
+              const CatalogResult &Ready = Next->second;
+              if (Ready.Status == 2) {
+                Empty++;
+                std::cout << "No station lines in event "
+                    << Ready.Name.c_str() << ", skipped." << std::endl;
+              }
+              else if (Ready.Status == 1) {
+                Failed++;
+                std::cout << "Inversion error in event "
+                    << Ready.Name.c_str() << "." << std::endl;
+              }
+              else if (DumpOrder.Length()) {
+                const Taquart::FaultSolution * Selected =
+                    &Ready.Solutions.DoubleCoupleSolution;
+                Taquart::String FSuffix = "dbcp";
+                for (int j = 1; j <= SolutionTypes.Length(); j++) {
+                  switch (SolutionTypes[j]) {
+                    case 'F':
+                      Selected = &Ready.Solutions.FullSolution;
+                      FSuffix = "full";
+                      break;
+                    case 'T':
+                      Selected = &Ready.Solutions.TraceNullSolution;
+                      FSuffix = "clvd";
+                      break;
+                    case 'D':
+                      Selected = &Ready.Solutions.DoubleCoupleSolution;
+                      FSuffix = "dbcp";
+                      break;
+                  }
+                  std::ostream &OutFile = Results.File(
+                      FilenameOut + "-" + FSuffix + ".asc");
+                  OutFile << Ready.Name.c_str() << "\t";
+                  DumpSolution(OutFile, DumpOrder, *Selected,
+                      Ready.Solutions.U_th);
+                }
+              }
+              Pending.erase(Next++);
+              Written++;
+            }
+          }
+        }
+
+        delete Core;
+      }
+
+      std::cout << Total - Empty << " events inverted";
+      if (Failed) std::cout << ", " << Failed << " inversion errors";
+      if (Empty) std::cout << ", " << Empty << " empty events skipped";
+      std::cout << "." << std::endl;
+      return Failed ? 1 : 0;
+    }
+
     Taquart::SMTInputData InputData;
 
     const unsigned int Size = 500;
-    int id = 0.0;
-    double duration = 0.0, displacement = 0.0;
-    double azimuth = 0.0, takeoff = 0.0, velocity = 0.0, distance = 0.0,
-        density = 0.0;
 
     // Load input data
     std::ifstream InputFile;
     InputFile.open(FilenameIn.c_str());
-    //char TempBuffer[100];
+    Taquart::SMTInputLine il;
     for (unsigned int i = 0; i < N; i++) {
-      InputFile >> id;
-      InputFile >> duration;
-      InputFile >> displacement;
-      InputFile >> azimuth;
-      InputFile >> takeoff;
-      InputFile >> velocity;
-      InputFile >> distance;
-      InputFile >> density;
-
-      // Dump to input file.
-      Taquart::SMTInputLine il;
-      //sprintf(TempBuffer, "%02d", id);
-      il.Name = Taquart::FormatFloat("%02d", id); /*!< Station name.*/
-      il.Id = id; /*!< Station id number.*/
-      il.Component = "ZZ"; //"ZZ";       /*!< Component.*/
-      il.MarkerType = ""; //"p*ons/p*max";      /*!< Type of the marker used.*/
-      il.Start = 0.0; //tstart;;           /*!< Start time [s].*/
-      il.End = duration; //tend;;             /*!< End time [s].*/
-      il.Duration = duration; /*!< Duration of signal [s].*/
-      il.Displacement = displacement; /*!< Displacement [m]. */
-      il.Incidence = 0; //incidence;       /*!< Angle of incidence [deg]. */
-      il.Azimuth = azimuth; /*!< Azimuth between station and source [deg]. */
-      il.TakeOff = takeoff; /*!< Takeoff angle [deg]. */
-      il.Distance = distance; /*!< Distance between station and source [m]. */
-      il.Density = density; /*!< Density [km/m**3]. */
-      il.Velocity = velocity; /*!< Average velocity [m/s]. */
-      il.PickActive = true;
-      il.ChannelActive = true;
-
+      ReadStation(InputFile, il);
       InputData.Add(il);
-
     }
     InputFile.close();
     bool Result = false;
@@ -511,120 +1031,387 @@ int main(int argc, char* argv[]) {
     std::vector<FaultSolutions> FSList;
 
     // Perform regular SMT inversion with all stations.
-    Taquart::FaultSolution fu;
-    Taquart::FaultSolution tr;
-    Taquart::FaultSolution dc;
 
+    // All inversions of the run share the station geometry.
+    Taquart::UsmtGeometryCache GeometryCache;
+
+    // The worker threads share the grid search levels of the L1 inversion.
+    Taquart::UsmtCore * MainCore = new Taquart::UsmtCore;
+    MainCore->GridThreads = Threads;
+    MainCore->L1WarmStart = WarmStart;
+    MainCore->L1Tolerance = WarmTolerance;
+    MainCore->L1Prune = Prune;
+    MainCore->L1Abandon = Abandon;
+    MainCore->LpExponent = LpExponent;
+    MainCore->HuberConstant = HuberConstant;
+    MainCore->DeadlineMs = DeadlineMs;
+    MainCore->ClosedFormEigen = ClosedFormEigen;
+    MainCore->LMDoubleCouple = LMDoubleCouple;
+    MainCore->DCGridStep = DCGridStep;
+    MainCore->Geometry = &GeometryCache;
     try {
       int ThreadProgress = 0;
-      USMTCore(InversionNormType, QualityType, InputData, &ThreadProgress);
+      MainCore->Run(InversionNormType, QualityType, InputData,
+          &ThreadProgress);
     }
     catch (...) {
+      delete MainCore;
       std::cout << "Inversion error." << std::endl;
       return 1;
     }
 
-    // Transfer solution.
-    TransferSolution(Taquart::stFullSolution, fu);
-    TransferSolution(Taquart::stTraceNullSolution, tr);
-    TransferSolution(Taquart::stDoubleCoupleSolution, dc);
+    if (WarmStart && L1Norm) {
+      const double *Points = MainCore->L1Points;
+      char Line[160];
+      sprintf(Line, "L1 grid search: %d of %d levels, %.4g of %.4g grid points"
+          " (%.1f%% saved)", MainCore->L1Levels[1], MainCore->L1Levels[2],
+          Points[1], Points[2],
+          Points[2] > 0.0 ? 100.0 * (1.0 - Points[1] / Points[2]) : 0.0);
+      std::cout << Line << std::endl;
+    }
+    if (Prune && L1Norm) {
+      const double *Pruned = MainCore->L1Pruned;
+      char Line[160];
+      sprintf(Line, "L1 branch and bound: %.4g of %.4g grid points pruned"
+          " (%.1f%%)", Pruned[1], Pruned[2],
+          Pruned[2] > 0.0 ? 100.0 * Pruned[1] / Pruned[2] : 0.0);
+      std::cout << Line << std::endl;
+    }
+    if (Abandon && L1Norm) {
+      const double *Visits = MainCore->L1Visits;
+      char Line[160];
+      sprintf(Line, "L1 early exit: %.2f of %d channels per evaluation"
+          " (%.4g evaluations)", Visits[2] > 0.0 ? Visits[1] / Visits[2] : 0.0,
+          int(Taquart::SMTInputView(InputData).Count()), Visits[2]);
+      std::cout << Line << std::endl;
+    }
+    if (LMDoubleCouple && !L1Norm) {
+      const Taquart::FaultSolution &Dc =
+          MainCore->Solution[Taquart::stDoubleCoupleSolution];
+      char Line[160];
+      sprintf(Line, "Double-couple fit: %d iterations, %s", Dc.DCIterations,
+          Dc.DCConverged ? "converged" : "not converged");
+      std::cout << Line << std::endl;
+    }
+    if (DCGridStep > 0.0) {
+      const double *Best = MainCore->DCBest;
+      const int *Size = MainCore->DCGridSize;
+      double Angle = 0.0;
+      const int Count = MainCore->DCRegion(DCGridTolerance, Angle);
+      char Line[160];
+      sprintf(Line, "DC grid search: strike %.1f, dip %.1f, rake %.1f"
+          " (misfit %.4g)", Best[1], Best[2], Best[3], Best[4]);
+      std::cout << Line << std::endl;
+      sprintf(Line, "DC grid search: %d of %d nodes within %.3g%% of the"
+          " misfit range (largest tensor angle %.1f deg)", Count,
+          Size[1] * Size[2] * Size[3], 100.0 * DCGridTolerance, Angle);
+      std::cout << Line << std::endl;
+
+      Taquart::String OutName = FilenameOut + "-dcgrid.asc";
+      ofstream OutFile(OutName.c_str(), std::ofstream::out);
+      const double SS = 360.0 / Size[1], SD = 90.0 / (Size[2] - 1),
+          SR = 360.0 / Size[3];
+      size_t k = 0;
+      for (int is = 0; is < Size[1]; is++)
+        for (int id = 0; id < Size[2]; id++)
+          for (int ir = 0; ir < Size[3]; ir++, k++)
+            OutFile << is * SS << "\t" << id * SD << "\t" << -180.0 + ir * SR
+                << "\t" << MainCore->DCSurface[k] << "\n";
+      OutFile.close();
+    }
+    if (MainCore->HaltReason) {
+      const char * Searches[3] = { "GSOL", "GSOL5", "GSOLA" };
+      char Line[160];
+      sprintf(Line, "L1 grid search %s in %s after %d levels (box width %.4g)",
+          MainCore->HaltReason == 1 ? "stopped by the deadline" : "cancelled",
+          Searches[MainCore->HaltSearch - 1], MainCore->HaltLevel,
+          MainCore->HaltWidth);
+      std::cout << Line << std::endl;
+    }
 
-    FaultSolutions fs;
+    // Transfer solution.
+    FSList.push_back(FaultSolutions());
+    FaultSolutions &fs = FSList.back();
     fs.Type = 'N';
     fs.Channel = 0;
-    fs.FullSolution = fu;
-    fs.TraceNullSolution = tr;
-    fs.DoubleCoupleSolution = dc;
-
-    FSList.push_back(fs);
+    MainCore->TransferSolution(Taquart::stFullSolution, fs.FullSolution);
+    MainCore->TransferSolution(Taquart::stTraceNullSolution,
+        fs.TraceNullSolution);
+    MainCore->TransferSolution(Taquart::stDoubleCoupleSolution,
+        fs.DoubleCoupleSolution);
+    if (DumpAmplitudes) MainCore->TransferAmplitudes(fs.U_th);
+    delete MainCore;
+
+    if (CompareL1) {
+      // Full and trace-null L1 solutions from both engines.
+      const Taquart::NormType Engines[2] = { Taquart::ntL1, Taquart::ntL1X };
+      const char * Names[2] = { "grid search (L1)   ", "linear prog. (L1X) " };
+      std::cout << "L1 engine            time [s]    misfit full"
+          "  misfit trace-null" << std::endl;
+      for (int e = 0; e < 2; e++) {
+        Taquart::UsmtCore * Core = new Taquart::UsmtCore;
+        Core->GridThreads = Threads;
+        Core->L1WarmStart = WarmStart;
+        Core->L1Tolerance = WarmTolerance;
+        Core->L1Prune = Prune;
+        Core->L1Abandon = Abandon;
+        Core->LpExponent = LpExponent;
+        Core->HuberConstant = HuberConstant;
+        Core->DeadlineMs = DeadlineMs;
+        Core->ClosedFormEigen = ClosedFormEigen;
+        Core->LMDoubleCouple = LMDoubleCouple;
+        Core->DCGridStep = DCGridStep;
+        Core->Geometry = &GeometryCache;
+        try {
+          int ThreadProgress = 0;
+          Core->Run(Engines[e], QualityType, InputData, &ThreadProgress);
+        }
+        catch (...) {
+          delete Core;
+          std::cout << "Inversion error." << std::endl;
+          return 1;
+        }
+        char Line[128];
+        sprintf(Line, "%s %10.4f %14.6e %14.6e", Names[e], Core->L1Time,
+            Core->L1Misfit[1], Core->L1Misfit[2]);
+        std::cout << Line;
+        // Problems which linear programming could not solve.
+        if (Engines[e] == Taquart::ntL1X && !Core->L1Exact[1])
+          std::cout << "  full: grid search fallback";
+        if (Engines[e] == Taquart::ntL1X && !Core->L1Exact[2])
+          std::cout << "  trace-null: grid search fallback";
+        std::cout << std::endl;
+        delete Core;
+      }
+    }
 
     if (NoiseTest) {
-      srand((unsigned) time(0));
-
-      const Taquart::SMTInputData fd = InputData;
-      for (unsigned int i = 0; i < AmplitudeN; i++) {
-        Taquart::SMTInputData td = fd;
-        Taquart::SMTInputLine InputLine;
-
-        //std::cout << i << std::endl;
-        int sample;
-        double u1, u2, z;
-        for (unsigned int j = 0; j < td.Count(); j++) {
-          td.Get(j, InputLine);
-          sample = rand();
-          u1 = (sample + 1) / (double(RAND_MAX) + 1);
-          sample = rand();
-          u2 = (sample + 1) / (double(RAND_MAX) + 1);
-          z = sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
-          //std::cout << RAND_MAX << " " << sample << " " << u1 << " " << u2<< " " << z << std::endl;
-          InputLine.Displacement = InputLine.Displacement
-              + z / 3.0 * InputLine.Displacement * AmpFactor;
-          td.Set(j, InputLine);
+      // Only the active channels of the input data are perturbed.
+      const Taquart::SMTInputView Active(InputData);
+      const int Count = AmplitudeN;
+      const int Channels = Active.Count();
+
+      // Samples are independent and their noise is generated from a counter
+      // based generator, so they are spread over the worker threads and the
+      // result does not depend on the number of threads.
+      std::vector<FaultSolutions> NoiseList(Count);
+      bool InversionError = false;
+
+      // For the L2 norm the design matrix does not depend on the amplitudes,
+      // thus it is inverted once and all perturbed amplitude vectors are
+      // solved together. Only the decomposition of each solution is left to
+      // the per-sample loop.
+      const bool Batch = (InversionNormType == Taquart::ntL2);
+      Taquart::UsmtCore * Setup = 0;
+      std::vector<double> UBatch;
+      std::vector<double> RMBatch;
+      if (Batch) {
+        UBatch.resize(Count * Channels);
+        RMBatch.resize(Count * L2BATCH_STRIDE);
+        for (int j = 0; j < Channels; j++) {
+          const double u = Active.Line(j).Displacement;
+          for (int i = 0; i < Count; i++) {
+            double z = NormalDeviate(Seed, i, j);
+            UBatch[i * Channels + j] = u + z / 3.0 * u * AmpFactor;
+          }
         }
 
-        // Calculate SMT with one station removed.
         try {
-          int ThreadProgress = 0;
-          USMTCore(InversionNormType, QualityType, td, &ThreadProgress);
+          Setup = new Taquart::UsmtCore;
+          Setup->Geometry = &GeometryCache;
+          Setup->PrepareL2Batch(Active);
+          Setup->SolveL2Batch(&UBatch[0], &RMBatch[0], Count);
         }
         catch (...) {
           std::cout << "Inversion error." << std::endl;
           return 1;
         }
+      }
 
-        // Transfer solution.
-        TransferSolution(Taquart::stFullSolution, fu);
-        TransferSolution(Taquart::stTraceNullSolution, tr);
-        TransferSolution(Taquart::stDoubleCoupleSolution, dc);
+#pragma omp parallel num_threads(Threads)
+      {
+        Taquart::UsmtCore * Core =
+            Batch ? new Taquart::UsmtCore(*Setup) : new Taquart::UsmtCore;
+        Core->L1WarmStart = WarmStart;
+        Core->L1Tolerance = WarmTolerance;
+        Core->L1Prune = Prune;
+        Core->L1Abandon = Abandon;
+        Core->LpExponent = LpExponent;
+        Core->HuberConstant = HuberConstant;
+        Core->DeadlineMs = DeadlineMs;
+        Core->ClosedFormEigen = ClosedFormEigen;
+        Core->LMDoubleCouple = LMDoubleCouple;
+        Core->DCGridStep = DCGridStep;
+        Core->Geometry = &GeometryCache;
+
+        // Perturbed amplitudes replace the displacements of the input data
+        // in a view, so the input data are never copied.
+        Taquart::SMTInputView View(InputData);
+        std::vector<double> UNoise(Batch ? 0 : InputData.Count());
+        if (!Batch) View.SetDisplacements(&UNoise[0]);
+
+#pragma omp for schedule(dynamic, 1)
+        for (int i = 0; i < Count; i++) {
+          // Calculate SMT with perturbed amplitudes.
+          try {
+            int ThreadProgress = 0;
+            if (Batch) {
+              Core->RunL2Batch(QualityType, &UBatch[i * Channels],
+                  &RMBatch[i * L2BATCH_STRIDE], &ThreadProgress);
+            }
+            else {
+              double z;
+              for (int j = 0; j < Channels; j++) {
+                const double u = View.Line(j).Displacement;
+                z = NormalDeviate(Seed, i, j);
+                UNoise[View.Source(j)] = u + z / 3.0 * u * AmpFactor;
+              }
+
+              Core->Run(InversionNormType, QualityType, View,
+                  &ThreadProgress);
+            }
+          }
+          catch (...) {
+#pragma omp critical
+            InversionError = true;
+            continue;
+          }
 
-        FaultSolutions fs;
-        fs.Type = 'A';
-        fs.Channel = 0;
-        fs.FullSolution = fu;
-        fs.TraceNullSolution = tr;
-        fs.DoubleCoupleSolution = dc;
+          // Transfer solution.
+          FaultSolutions &fs = NoiseList[i];
+          fs.Type = 'A';
+          fs.Channel = 0;
+          Core->TransferSolution(Taquart::stFullSolution, fs.FullSolution);
+          Core->TransferSolution(Taquart::stTraceNullSolution,
+              fs.TraceNullSolution);
+          Core->TransferSolution(Taquart::stDoubleCoupleSolution,
+              fs.DoubleCoupleSolution);
+          if (DumpAmplitudes) Core->TransferAmplitudes(fs.U_th);
+        }
 
-        FSList.push_back(fs);
+        delete Core;
+      }
+      delete Setup;
+
+      if (InversionError) {
+        std::cout << "Inversion error." << std::endl;
+        return 1;
       }
+
+      const size_t First = FSList.size();
+      FSList.resize(First + Count);
+      for (int i = 0; i < Count; i++)
+        FSList[First + i].Swap(NoiseList[i]);
     }
     else {
       // Perform additional jacknife tests.
       if (JacknifeTest) {
-        const Taquart::SMTInputData fd = InputData;
-        const unsigned int Count = InputData.Count();
-
-        // Remove one channel, calculate the solution,
-        for (unsigned int i = 0; i < Count; i++) {
-          Taquart::SMTInputData td = fd;
-          Taquart::SMTInputLine InputLine;
-          td.Get(i, InputLine);
-          int channel = InputLine.Id;
-          td.Remove(i);
-
-          // Calculate SMT with one station removed.
+        // Each active channel is left out in turn.
+        const Taquart::SMTInputView Active(InputData);
+        const int Count = Active.Count();
+
+        // Each leave-one-out inversion is independent, so they are spread
+        // over the worker threads, every thread using its own solver context.
+        // The results are stored by channel index and appended to FSList
+        // afterwards, so the output does not depend on the number of threads.
+        std::vector<FaultSolutions> JKList(Count);
+        std::vector<int> Channels(Count);
+        bool InversionError = false;
+
+        for (int i = 0; i < Count; i++)
+          Channels[i] = Active.Line(i).Id;
+
+        // For the L2 norm the full data set is inverted once and each station
+        // is removed by a rank-one downdate of the normal matrices.
+        const bool Downdate = (InversionNormType == Taquart::ntL2);
+        Taquart::UsmtCore * Full = 0;
+        if (Downdate) {
           try {
-            int ThreadProgress = 0;
-            USMTCore(InversionNormType, QualityType, td, &ThreadProgress);
+            Full = new Taquart::UsmtCore;
+            Full->Geometry = &GeometryCache;
+            Full->PrepareL2Batch(Active);
           }
           catch (...) {
             std::cout << "Inversion error." << std::endl;
             return 1;
           }
+        }
 
-          // Transfer solution.
-          TransferSolution(Taquart::stFullSolution, fu);
-          TransferSolution(Taquart::stTraceNullSolution, tr);
-          TransferSolution(Taquart::stDoubleCoupleSolution, dc);
+#pragma omp parallel num_threads(Threads)
+        {
+          Taquart::UsmtCore * Core = new Taquart::UsmtCore;
+          Core->L1WarmStart = WarmStart;
+          Core->L1Tolerance = WarmTolerance;
+          Core->L1Prune = Prune;
+          Core->L1Abandon = Abandon;
+          Core->LpExponent = LpExponent;
+          Core->HuberConstant = HuberConstant;
+          Core->DeadlineMs = DeadlineMs;
+          Core->ClosedFormEigen = ClosedFormEigen;
+          Core->LMDoubleCouple = LMDoubleCouple;
+          Core->DCGridStep = DCGridStep;
+          Core->Geometry = &GeometryCache;
+
+          // Channels are removed by masking them in a view of the input data.
+          Taquart::SMTInputView View(InputData);
+
+          // Remove one channel, calculate the solution,
+#pragma omp for schedule(dynamic, 1)
+          for (int i = 0; i < Count; i++) {
+            int channel = Channels[i];
+
+            // Calculate SMT with one station removed.
+            try {
+              int ThreadProgress = 0;
+              if (Downdate) {
+                Core->RunL2Jackknife(*Full, i + 1, QualityType,
+                    &ThreadProgress);
+              }
+              else {
+                const unsigned int Line = Active.Source(i);
+                View.SetActive(Line, false);
+                try {
+                  Core->Run(InversionNormType, QualityType, View,
+                      &ThreadProgress);
+                }
+                catch (...) {
+                  View.SetActive(Line, true);
+                  throw;
+                }
+                View.SetActive(Line, true);
+              }
+            }
+            catch (...) {
+#pragma omp critical
+              InversionError = true;
+              continue;
+            }
 
-          FaultSolutions fs;
-          fs.Type = 'J';
-          fs.Channel = channel;
-          fs.FullSolution = fu;
-          fs.TraceNullSolution = tr;
-          fs.DoubleCoupleSolution = dc;
+            // Transfer solution.
+            FaultSolutions &fs = JKList[i];
+            fs.Type = 'J';
+            fs.Channel = channel;
+            Core->TransferSolution(Taquart::stFullSolution, fs.FullSolution);
+            Core->TransferSolution(Taquart::stTraceNullSolution,
+                fs.TraceNullSolution);
+            Core->TransferSolution(Taquart::stDoubleCoupleSolution,
+                fs.DoubleCoupleSolution);
+            if (DumpAmplitudes) Core->TransferAmplitudes(fs.U_th);
+          }
 
-          FSList.push_back(fs);
+          delete Core;
         }
+        delete Full;
+
+        if (InversionError) {
+          std::cout << "Inversion error." << std::endl;
+          return 1;
+        }
+
+        const size_t First = FSList.size();
+        FSList.resize(First + Count);
+        for (int i = 0; i < Count; i++)
+          FSList[First + i].Swap(JKList[i]);
       }
     }
 
@@ -659,8 +1446,11 @@ int main(int argc, char* argv[]) {
     else
       DrawDC = false;
 
+    // The result files stay open for all rows of the run.
+    Taquart::ResultWriter Results;
     for (unsigned int j = 0; j < FSList.size(); j++) {
-      Taquart::FaultSolution Solution = FSList[j].DoubleCoupleSolution;
+      const Taquart::FaultSolution * Selected =
+          &FSList[j].DoubleCoupleSolution;
       char Type = FSList[j].Type;
       int Channel = FSList[j].Channel;
 
@@ -668,105 +1458,31 @@ int main(int argc, char* argv[]) {
       for (int i = 1; i <= SolutionTypes.Length(); i++) {
         switch (SolutionTypes[i]) {
           case 'F':
-            Solution = FSList[j].FullSolution;
+            Selected = &FSList[j].FullSolution;
             FSuffix = "full";
             break;
           case 'T':
-            Solution = FSList[j].TraceNullSolution;
+            Selected = &FSList[j].TraceNullSolution;
             FSuffix = "clvd";
             break;
           case 'D':
-            Solution = FSList[j].DoubleCoupleSolution;
+            Selected = &FSList[j].DoubleCoupleSolution;
             FSuffix = "dbcp";
             break;
         }
+        const Taquart::FaultSolution &Solution = *Selected;
 
         // Output text data if necessary.
         if (DumpOrder.Length()) {
-          Taquart::String OutName = FilenameOut + "-" + FSuffix + ".asc";
-          ofstream OutFile(OutName.c_str(),
-              std::ofstream::out | std::ofstream::app);
+          std::ostream &OutFile = Results.File(
+              FilenameOut + "-" + FSuffix + ".asc");
 
           if (JacknifeTest) {
             // Dump additional information when Jacknife test performed.
             OutFile << Type << "\t" << Channel << "\t";
           }
 
-          for (int i = 1; i <= DumpOrder.Length(); i++) {
-            // M - moment, D - decomposition, A - axis, F - fault planes,
-            // C - moment in CMT convention.
-
-            // Dump moment tensor components.
-            if (DumpOrder[i] == 'M') {
-              OutFile << Solution.M[1][1] << "\t";
-              OutFile << Solution.M[1][2] << "\t";
-              OutFile << Solution.M[1][3] << "\t";
-              OutFile << Solution.M[2][2] << "\t";
-              OutFile << Solution.M[2][3] << "\t";
-              OutFile << Solution.M[3][3] << "\t";
-            }
-
-            // Dump moment tensor components in CMT convention.
-            if (DumpOrder[i] == 'C') {
-              OutFile << Solution.M[3][3] << "\t";
-              OutFile << Solution.M[1][1] << "\t";
-              OutFile << Solution.M[2][2] << "\t";
-              OutFile << Solution.M[1][3] << "\t";
-              OutFile << -Solution.M[2][3] << "\t";
-              OutFile << -Solution.M[1][2] << "\t";
-            }
-
-            if (DumpOrder[i] == 'D') {
-              OutFile << Solution.EXPL << "\t";
-              OutFile << Solution.CLVD << "\t";
-              OutFile << Solution.DBCP << "\t";
-            }
-
-            if (DumpOrder[i] == 'A') {
-              OutFile << Solution.PXTR << "\t";
-              OutFile << Solution.PXPL << "\t";
-              OutFile << Solution.TXTR << "\t";
-              OutFile << Solution.TXPL << "\t";
-              OutFile << Solution.BXTR << "\t";
-              OutFile << Solution.BXPL << "\t";
-            }
-
-            if (DumpOrder[i] == 'F') {
-              OutFile << Solution.FIA << "\t";
-              OutFile << Solution.DLA << "\t";
-              OutFile << Solution.RAKEA << "\t";
-              OutFile << Solution.FIB << "\t";
-              OutFile << Solution.DLB << "\t";
-              OutFile << Solution.RAKEB << "\t";
-            }
-
-            if (DumpOrder[i] == 'W') {
-              OutFile << Solution.M0 << "\t";
-              OutFile << Solution.MT << "\t";
-              OutFile << Solution.ERR << "\t";
-              OutFile << Solution.MAGN << "\t";
-            }
-
-            if (DumpOrder[i] == 'Q') {
-              OutFile << Solution.QI << "\t";
-            }
-
-            if (DumpOrder[i] == 'T') {
-              OutFile << Solution.Type.c_str() << "\t";
-            }
-
-            if (DumpOrder[i] == 'U') {
-              for (int r = 0; r < Solution.U_n; r++)
-                OutFile << Solution.U_th[r] << "\t";
-            }
-
-            if (DumpOrder[i] == 'E') {
-              OutFile << Solution.UERR << "\t";
-            }
-          }
-
-          OutFile << "\n";
-          OutFile.close();
+          DumpSolution(OutFile, DumpOrder, Solution, FSList[j].U_th);
         }
 
         // Output picture name
@@ -952,10 +1668,10 @@ void GenerateBallCairo(Taquart::TriCairo_Meca &Meca,
       }
 
       // "Normal fault","Strike fault","Reverse fault"
-      if (s->Type == "Normal fault") {
+      if (s->Type == Taquart::ftNormalFault) {
         Meca.BDCColor = Taquart::TCColor(0.0, 0.0, 1.0, 0.7);
       }
-      else if (s->Type == "Reverse fault") {
+      else if (s->Type == Taquart::ftReverseFault) {
         Meca.BDCColor = Taquart::TCColor(1.0, 0.0, 0.0, 0.7);
       }
       else {
@@ -3,7 +3,6 @@
 #define MOMENT_TENSOR_H_
 //---------------------------------------------------------------------------
 
-#define MAXCHANNEL 128
 #define MIN_ALLOWED_CHANNELS 8
 
 //-----------------------------------------------------------------------------
@@ -41,7 +40,10 @@ namespace Taquart {
   //! Norm type used in calculation of the moment tensor solution.
   enum NormType {
     ntL1, /*!< L1 norm used. */
-    ntL2 /*!< L2 norm used. */
+    ntL2, /*!< L2 norm used. */
+    ntL1X, /*!< L1 norm used, exact (linear programming) solution. */
+    ntLp, /*!< Lp norm (1<=p<=2) used, solved by IRLS. */
+    ntHuber /*!< Huber norm used, solved by IRLS. */
   };
 
   //! Seismic moment tensor solution type.
@@ -53,6 +55,17 @@ namespace Taquart {
     stTraceNullSolution = 2, /*!< Trace-null solution.*/
     stDoubleCoupleSolution = 3 /*!< Double-couple solution.*/
   };
+
+  //! Fault type of the seismic moment tensor solution.
+  /*! Determined by the most vertical of the P, B and T axes.
+   *  \ingroup foci
+   */
+  enum FaultType {
+    ftUnknown = 0, /*!< Not determined.*/
+    ftNormalFault = 1, /*!< Normal fault (P axis).*/
+    ftStrikeFault = 2, /*!< Strike fault (B axis).*/
+    ftReverseFault = 3 /*!< Reverse fault (T axis).*/
+  };
 }
 
 //---------------------------------------------------------------------------
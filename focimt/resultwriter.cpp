@@ -0,0 +1,94 @@
+//---------------------------------------------------------------------------
+#include "resultwriter.h"
+
+//---------------------------------------------------------------------------
+using namespace Taquart;
+
+//---------------------------------------------------------------------------
+FileResultSink::FileResultSink(const Taquart::String &FileName) {
+  File = fopen(FileName.c_str(), "a");
+  // The blocks are already buffered.
+  if (File) setvbuf(File, 0, _IONBF, 0);
+}
+
+//---------------------------------------------------------------------------
+FileResultSink::~FileResultSink(void) {
+  if (File) fclose(File);
+}
+
+//---------------------------------------------------------------------------
+bool FileResultSink::Write(const char *Data, size_t Size) {
+  return File && fwrite(Data, 1, Size, File) == Size;
+}
+
+//---------------------------------------------------------------------------
+ResultBuffer::ResultBuffer(ResultSink *ASink, size_t ABlockSize) :
+    Sink(ASink), Block(ABlockSize > 0 ? ABlockSize : 1) {
+  setp(&Block[0], &Block[0] + Block.size());
+}
+
+//---------------------------------------------------------------------------
+ResultBuffer::~ResultBuffer(void) {
+  Drain();
+  delete Sink;
+}
+
+//---------------------------------------------------------------------------
+bool ResultBuffer::Drain(void) {
+  const size_t Size = pptr() - pbase();
+  setp(&Block[0], &Block[0] + Block.size());
+  return Size == 0 || Sink->Write(&Block[0], Size);
+}
+
+//---------------------------------------------------------------------------
+ResultBuffer::int_type ResultBuffer::overflow(int_type c) {
+  if (!Drain()) return traits_type::eof();
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+//---------------------------------------------------------------------------
+int ResultBuffer::sync(void) {
+  return Drain() ? 0 : -1;
+}
+
+//---------------------------------------------------------------------------
+ResultWriter::ResultWriter(size_t ABlockSize) :
+    BlockSize(ABlockSize) {
+}
+
+//---------------------------------------------------------------------------
+ResultWriter::~ResultWriter(void) {
+  for (size_t i = 0; i < Files.size(); i++) {
+    delete Files[i].Stream;
+    delete Files[i].Buffer;
+  }
+}
+
+//---------------------------------------------------------------------------
+std::ostream & ResultWriter::File(const Taquart::String &FileName) {
+  for (size_t i = 0; i < Files.size(); i++)
+    if (Files[i].Name == FileName) return *Files[i].Stream;
+
+  Entry E;
+  E.Name = FileName;
+  E.Buffer = new ResultBuffer(CreateSink(FileName), BlockSize);
+  E.Stream = new std::ostream(E.Buffer);
+  Files.push_back(E);
+  return *E.Stream;
+}
+
+//---------------------------------------------------------------------------
+void ResultWriter::Flush(void) {
+  for (size_t i = 0; i < Files.size(); i++)
+    Files[i].Stream->flush();
+}
+
+//---------------------------------------------------------------------------
+ResultSink * ResultWriter::CreateSink(const Taquart::String &FileName) {
+  return new FileResultSink(FileName);
+}
+
@@ -0,0 +1,154 @@
+//---------------------------------------------------------------------------
+#ifndef resultwriterH
+#define resultwriterH
+//---------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// Source: resultwriter.h
+// Module: focimt
+// Buffered output of the text result files.
+//
+// Copyright (c) 2003-2015, Grzegorz Kwiatek.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+#include <trilib/string.h>
+
+namespace Taquart {
+  //! Destination of the blocks of one result file.
+  /*! The backend of the ResultWriter class. Write receives the text of the
+   *  file in blocks, in the order in which it was written to the stream.
+   *  \ingroup foci
+   */
+  class ResultSink {
+    public:
+      virtual ~ResultSink(void) {
+      }
+
+      //! Store the block.
+      /*! \param Data Text of the block.
+       *  \param Size Length of the block.
+       *  \return \p false on error.
+       */
+      virtual bool Write(const char *Data, size_t Size) = 0;
+  };
+
+  //! Result file appended with one write call per block.
+  /*! \ingroup foci
+   */
+  class FileResultSink: public ResultSink {
+    public:
+      //! Open the file in append mode.
+      /*! \param FileName Name of the file.
+       */
+      FileResultSink(const Taquart::String &FileName);
+      ~FileResultSink(void);
+      bool Write(const char *Data, size_t Size);
+
+    private:
+      FILE *File;
+
+      FileResultSink(const FileResultSink &Source);
+      FileResultSink & operator=(const FileResultSink &Source);
+  };
+
+  //! Stream buffer passing full blocks to the sink.
+  /*! \ingroup foci
+   */
+  class ResultBuffer: public std::streambuf {
+    public:
+      //! Constructor.
+      /*! \param ASink Backend, deleted by the buffer.
+       *  \param ABlockSize Size of the block [bytes].
+       */
+      ResultBuffer(ResultSink *ASink, size_t ABlockSize);
+      ~ResultBuffer(void);
+
+    protected:
+      int_type overflow(int_type c);
+      int sync(void);
+
+    private:
+      ResultSink *Sink;
+      std::vector<char> Block;
+
+      bool Drain(void);
+      ResultBuffer(const ResultBuffer &Source);
+      ResultBuffer & operator=(const ResultBuffer &Source);
+  };
+
+  //! Buffered text result files of the run.
+  /*! Every result file is opened once, on its first use, and kept open with
+   *  its own buffered stream until the writer is flushed or destroyed, so
+   *  the rows of all solutions are written in blocks of BlockSize bytes.
+   *  The files are appended to, as the rows of subsequent runs. Derived
+   *  classes may supply another backend in CreateSink.
+   *  \ingroup foci
+   */
+  class ResultWriter {
+    public:
+      //! Constructor.
+      /*! \param ABlockSize Size of the block passed to the backend [bytes].
+       */
+      ResultWriter(size_t ABlockSize = 65536);
+
+      //! Destructor, writes out and closes all files.
+      virtual ~ResultWriter(void);
+
+      //! Stream of the result file.
+      /*! \param FileName Name of the file.
+       *  \return Stream of the file, created on the first call.
+       */
+      std::ostream & File(const Taquart::String &FileName);
+
+      //! Write out the buffered text of all files.
+      void Flush(void);
+
+    protected:
+      //! Create the backend of the file.
+      /*! \param FileName Name of the file.
+       *  \return Backend, deleted by the writer.
+       */
+      virtual ResultSink * CreateSink(const Taquart::String &FileName);
+
+    private:
+      struct Entry {
+          Taquart::String Name;
+          ResultBuffer *Buffer;
+          std::ostream *Stream;
+      };
+      std::vector<Entry> Files; /*!< Few files, searched linearly. */
+      size_t BlockSize;
+
+      ResultWriter(const ResultWriter &Source);
+      ResultWriter & operator=(const ResultWriter &Source);
+  };
+}
+
+//---------------------------------------------------------------------------
+#endif
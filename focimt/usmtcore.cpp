@@ -2,75 +2,389 @@
 #include <trilib/fortranmath.h>
 #include <trilib/georoutines.h>
 #include "usmtcore.h"
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USMT_AVX
+#include <immintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#elif defined(_WIN32)
+#include <time.h>
+#else
+#include <sys/time.h>
+#endif
 //---------------------------------------------------------------------------
 
 //---------------------------------------------------------------------------
-using namespace Taquart::UsmtCore;
 using namespace Taquart;
 
-namespace Taquart {
-  namespace UsmtCore {
-    int NDAE[10] = { 0, 36, 36, 32, 32, 24, 24, 16, 8, 4 };
-    double U[MAXCHANNEL + 1];
-    double AZM[MAXCHANNEL + 1];
-    double TKF[MAXCHANNEL + 1];
-    double GA[MAXCHANNEL + 1][3 + 1];
-    double A[MAXCHANNEL + 1][6 + 1];
-    double FIJ[3 + 1][3 + 1][MAXCHANNEL + 1];
-    double RM[6 + 1][3 + 1];
-    double COV[6 + 1][6 + 1][3 + 1];
-    int RO[MAXCHANNEL + 1];
-    int VEL[MAXCHANNEL + 1];
-    int R[MAXCHANNEL + 1];
-    double UTH[MAXCHANNEL + 1];
-    int N = 0;
-    double TROZ = 0.0;
-    double QSD = 0.0;
-    double QF = 0.0;
-    bool FSTCLL = true;
-    int ICOND = 0;
-    Taquart::FaultSolution Solution[4];
-    int ISTA = 1;
-    int * ThreadProgress;
-  } // namespace UsmtCore
-} // namespace Foci
+//---------------------------------------------------------------------------
+const int Taquart::UsmtCore::NDAE[10] = { 0, 36, 36, 32, 32, 24, 24, 16, 8, 4 };
 
 //---------------------------------------------------------------------------
-void TransferSolution(Taquart::SolutionType AType,
-    std::list<Taquart::FaultSolution> &ASolution) {
-  ASolution.push_back(Taquart::UsmtCore::Solution[int(AType)]);
+// Residual sums of the L1 objectives F1 and F2 over the stations 1..N. Every
+// grid point is summed over the stations in turn, as in the original F1 and
+// F2, so the misfits do not depend on the kernel. The lane kernels evaluate
+// the 7 points of the innermost coordinate of a grid level together, one
+// point per lane: COL(L,I) (8 values per station, the 8th unused) is the
+// contribution of that coordinate for the L-th point, P(I) the partial sum of
+// the other ones and C(I), if given, a term subtracted after the column.
+// The kernel is chosen at run time (AVX-512, AVX, scalar). The lane kernels
+// only add and subtract, so AVX2 and FMA would not change them. FMA in the
+// partial sums and the reduced trace-null matrix HT in F2 would change the
+// rounding of the misfits, and with it the L1 solutions.
+namespace {
+  typedef void (*L1KernelLanes)(const double P[], const double C[],
+      const double COL[], const double U[], int N, double F[]);
+
+  double L1SumF1(const double PART[], const double COL[], const double U[],
+      int N) {
+    double S = 0.0;
+    for (int i = 1; i <= N; i++)
+      S = S + fabs(PART[i] + COL[i] - U[i]);
+    return S;
+  }
+
+  // The sum A(I,1..5)*X(1..5)-A(I,6)*(X(1)+X(4)) of F2, from the columns of A.
+  inline double L1TermF2(const double * const H[], const double X[], int i) {
+    double SUM = H[1][i] * X[1] + H[2][i] * X[2] + H[3][i] * X[3]
+        + H[4][i] * X[4] + H[5][i] * X[5];
+    return SUM - H[6][i] * (X[1] + X[4]);
+  }
+
+  double L1SumF2(const double * const H[], const double X[], const double U[],
+      int N) {
+    double S = 0.0;
+    for (int i = 1; i <= N; i++)
+      S = S + fabs(L1TermF2(H, X, i) - U[i]);
+    return S;
+  }
+
+  void L1LanesScalar(const double P[], const double C[], const double COL[],
+      const double U[], int N, double F[]) {
+    for (int l = 0; l < 8; l++)
+      F[l] = 0.0;
+    for (int i = 1; i <= N; i++)
+      for (int l = 0; l < 8; l++) {
+        double R = P[i] + COL[8 * i + l];
+        if (C) R = R - C[i];
+        F[l] = F[l] + fabs(R - U[i]);
+      }
+  }
+
+#ifdef USMT_AVX
+  // No FMA: products and sums are rounded exactly as in the scalar kernel.
+  __attribute__((target("avx")))
+  void L1LanesAVX(const double P[], const double C[], const double COL[],
+      const double U[], int N, double F[]) {
+    const __m256d SIGN = _mm256_set1_pd(-0.0);
+    __m256d S1 = _mm256_setzero_pd();
+    __m256d S2 = _mm256_setzero_pd();
+    for (int i = 1; i <= N; i++) {
+      const __m256d PI = _mm256_set1_pd(P[i]);
+      const __m256d UI = _mm256_set1_pd(U[i]);
+      __m256d R1 = _mm256_add_pd(PI, _mm256_loadu_pd(&COL[8 * i]));
+      __m256d R2 = _mm256_add_pd(PI, _mm256_loadu_pd(&COL[8 * i + 4]));
+      if (C) {
+        const __m256d CI = _mm256_set1_pd(C[i]);
+        R1 = _mm256_sub_pd(R1, CI);
+        R2 = _mm256_sub_pd(R2, CI);
+      }
+      R1 = _mm256_sub_pd(R1, UI);
+      R2 = _mm256_sub_pd(R2, UI);
+      S1 = _mm256_add_pd(S1, _mm256_andnot_pd(SIGN, R1));
+      S2 = _mm256_add_pd(S2, _mm256_andnot_pd(SIGN, R2));
+    }
+    _mm256_storeu_pd(F, S1);
+    _mm256_storeu_pd(F + 4, S2);
+  }
+
+  // All 8 lanes in one register, again without FMA.
+  __attribute__((target("avx512f")))
+  void L1LanesAVX512(const double P[], const double C[], const double COL[],
+      const double U[], int N, double F[]) {
+    __m512d S = _mm512_setzero_pd();
+    for (int i = 1; i <= N; i++) {
+      __m512d R = _mm512_add_pd(_mm512_set1_pd(P[i]),
+          _mm512_loadu_pd(&COL[8 * i]));
+      if (C) R = _mm512_sub_pd(R, _mm512_set1_pd(C[i]));
+      R = _mm512_sub_pd(R, _mm512_set1_pd(U[i]));
+      S = _mm512_add_pd(S, _mm512_abs_pd(R));
+    }
+    _mm512_storeu_pd(F, S);
+  }
+#endif
+
+  L1KernelLanes SelectL1KernelLanes(void) {
+#ifdef USMT_AVX
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return L1LanesAVX512;
+    if (__builtin_cpu_supports("avx")) return L1LanesAVX;
+#endif
+    return L1LanesScalar;
+  }
+
+  // Wall clock time in seconds.
+  double WallTime(void) {
+#ifdef _OPENMP
+    return omp_get_wtime();
+#elif defined(_WIN32)
+    // Whole seconds only; build with OpenMP for a finer deadline.
+    return double(time(0));
+#else
+    timeval T;
+    gettimeofday(&T, 0);
+    return double(T.tv_sec) + 1.0e-6 * double(T.tv_usec);
+#endif
+  }
+
+  // Bounds for the branch and bound mode of GSOL and GSOL5. COL(K,J,I) is
+  // the contribution A(I,K)*XTRY(K) of the J-th value of the K-th
+  // coordinate. CLO(K,I) and CHI(K,I) are the least and the largest
+  // contributions of the coordinates after K. MARGIN covers the rounding of
+  // both the bound and the objective, so a subtree is pruned only if none of
+  // its points could pass TRY.LE.VAL.
+  void L1Bounds(int NP, const Taquart::ChannelRows<double, 7 + 1> COL[],
+      const double U[], int N, double * const CLO[], double * const CHI[],
+      double &MARGIN) {
+    MARGIN = 0.0;
+    for (int i = 1; i <= N; i++) {
+      CLO[NP][i] = 0.0;
+      CHI[NP][i] = 0.0;
+      double MAG = fabs(U[i]);
+      for (int k = NP; k >= 2; k--) {
+        const double C1 = COL[k][1][i];
+        const double C7 = COL[k][7][i];
+        CLO[k - 1][i] = CLO[k][i] + (C1 < C7 ? C1 : C7);
+        CHI[k - 1][i] = CHI[k][i] + (C1 < C7 ? C7 : C1);
+        MAG = MAG + (fabs(C1) > fabs(C7) ? fabs(C1) : fabs(C7));
+      }
+      MAG = MAG + fabs(COL[1][1][i]) + fabs(COL[1][7][i]);
+      MARGIN = MARGIN + MAG;
+    }
+    MARGIN = MARGIN * 1.0e-12;
+  }
+
+  // Lower bound of the L1 misfit over all points with the partial sum PART
+  // of the fixed coordinates and the free ones between the bounds LO and HI.
+  double L1Lower(const double PART[], const double LO[], const double HI[],
+      const double U[], int N) {
+    double SUM = 0.0;
+    for (int i = 1; i <= N; i++) {
+      const double D1 = PART[i] + LO[i] - U[i];
+      const double D2 = U[i] - PART[i] - HI[i];
+      if (D1 > 0.0)
+        SUM = SUM + D1;
+      else if (D2 > 0.0) SUM = SUM + D2;
+    }
+    return SUM;
+  }
+
+  // Early exit kernels: the terms of F1 and F2 summed over the channels in
+  // the order ORDER until the sum exceeds LIMIT. The number of channels
+  // visited is returned in VISITED.
+  double L1SumF1Abandon(const double PART[], const double COL[],
+      const double U[], const int ORDER[], int N, double LIMIT,
+      int &VISITED) {
+    double S = 0.0;
+    for (int k = 1; k <= N; k++) {
+      const int i = ORDER[k];
+      S += fabs(PART[i] + COL[i] - U[i]);
+      if (S > LIMIT) {
+        VISITED = k;
+        return S;
+      }
+    }
+    VISITED = N;
+    return S;
+  }
+
+  double L1SumF2Abandon(const double * const H[], const double X[],
+      const double U[], const int ORDER[], int N, double LIMIT,
+      int &VISITED) {
+    double S = 0.0;
+    for (int k = 1; k <= N; k++) {
+      const int i = ORDER[k];
+      S += fabs(L1TermF2(H, X, i) - U[i]);
+      if (S > LIMIT) {
+        VISITED = k;
+        return S;
+      }
+    }
+    VISITED = N;
+    return S;
+  }
+
+  // Scalar moment M>=0 minimising SUM|U(I)-M*G(I)| (the weighted median of
+  // U/G with the weights |G|), returned with that misfit in F. R is a work
+  // array of the ratios and their stations, sorted once (ties by station).
+  double DCL1Moment(const double U[], const double G[], int N,
+      std::vector<std::pair<double, int> > &R, double &F) {
+    if (R.size() < size_t(N)) R.resize(N);
+    int K = 0;
+    double WSUM = 0.0;
+    for (int i = 1; i <= N; i++)
+      if (G[i] != 0.0) {
+        R[K].first = U[i] / G[i];
+        R[K].second = i;
+        WSUM = WSUM + fabs(G[i]);
+        K++;
+      }
+    std::sort(R.begin(), R.begin() + K);
+    double M = 0.0, CUM = 0.0;
+    for (int j = 0; j < K; j++) {
+      CUM = CUM + fabs(G[R[j].second]);
+      if (2.0 * CUM >= WSUM) {
+        M = R[j].first;
+        break;
+      }
+    }
+    if (M < 0.0) M = 0.0;
+    F = 0.0;
+    for (int i = 1; i <= N; i++)
+      F = F + fabs(U[i] - M * G[i]);
+    return M;
+  }
+
+  // Selected once, at start-up.
+  const L1KernelLanes L1Lanes = SelectL1KernelLanes();
 }
 
 //---------------------------------------------------------------------------
-void TransferSolution(Taquart::SolutionType AType,
-    Taquart::FaultSolution &ASolution) {
-  ASolution = Taquart::UsmtCore::Solution[int(AType)];
+Taquart::UsmtCore::UsmtCore(void) {
+  // The per-channel arrays are sized by RDINP (see CHANNELS).
+  Zero(&RM[0][0], (6 + 1) * (3 + 1));
+  Zero(&COV[0][0][0], (6 + 1) * (6 + 1) * (3 + 1));
+  Zero(&DAE[0][0], (212 + 1) * (3 + 1));
+  N = 0;
+  TROZ = 0.0;
+  QSD = 0.0;
+  QF = 0.0;
+  FSTCLL = true;
+  ICOND = 0;
+  ISTA = 1;
+  ThreadProgress = 0;
+  GridThreads = 1;
+  L1Misfit[0] = L1Misfit[1] = L1Misfit[2] = 0.0;
+  L1Time = 0.0;
+  L1Exact[0] = L1Exact[1] = L1Exact[2] = false;
+  L1WarmStart = false;
+  L1Tolerance = 0.0;
+  L1Levels[0] = L1Levels[1] = L1Levels[2] = 0;
+  L1Points[0] = L1Points[1] = L1Points[2] = 0.0;
+  L1Prune = false;
+  L1Pruned[0] = L1Pruned[1] = L1Pruned[2] = 0.0;
+  L1Abandon = false;
+  L1Visits[0] = L1Visits[1] = L1Visits[2] = 0.0;
+  LpExponent = 1.5;
+  HuberConstant = 1.345;
+  DeadlineMs = 0.0;
+  HaltReason = HaltSearch = HaltLevel = 0;
+  HaltWidth = 0.0;
+  StartTime = 0.0;
+  ClosedFormEigen = false;
+  LMDoubleCouple = false;
+  DCITER = 0;
+  DCGridStep = 0.0;
+  Geometry = 0;
+  GEOREADY = false;
+  JEZOK = false;
+  NUTH = 0;
+  DCGridSize[0] = DCGridSize[1] = DCGridSize[2] = DCGridSize[3] = 0;
+  Zero(DCBest, 5);
 }
 
 //---------------------------------------------------------------------------
-void USMTCore(Taquart::NormType ANormType, int QualityType,
+void Taquart::UsmtCore::Run(Taquart::NormType ANormType, int QualityType,
     Taquart::SMTInputData &InputData, int * const AThreadProgress) {
+  Run(ANormType, QualityType, Taquart::SMTInputView(InputData),
+      AThreadProgress);
+}
+
+//---------------------------------------------------------------------------
+void Taquart::UsmtCore::Run(Taquart::NormType ANormType, int QualityType,
+    const Taquart::SMTInputView &InputData, int * const AThreadProgress) {
   int IEXP = 0;
   ThreadProgress = AThreadProgress;
+  StartTime = WallTime();
+  HaltReason = HaltSearch = HaltLevel = 0;
+  HaltWidth = 0.0;
   PROGRESS(0, 350);
   RDINP(InputData);
-  ANGGA();
-  JEZ();
+  GEOMET();
   switch (ANormType) {
     case Taquart::ntL1:
       MOM2(false, QualityType);
+      if (L1WarmStart) L1START();
       SIZEMM(IEXP);
       MOM1(IEXP, QualityType);
       break;
+    case Taquart::ntL1X:
+      MOM2(false, QualityType);
+      if (L1WarmStart) L1START();
+      SIZEMM(IEXP);
+      MOM1(IEXP, QualityType, true);
+      break;
     case Taquart::ntL2:
       MOM2(true, QualityType);
       break;
+    case Taquart::ntLp:
+    case Taquart::ntHuber:
+      IRLS(ANormType);
+      MOM2(true, QualityType, true);
+      break;
   }
   PROGRESS(360, 350);
 }
 
 //---------------------------------------------------------------------------
-void Taquart::UsmtCore::MOM1(int &IEXP, int QualityType) {
+void Taquart::UsmtCore::TransferSolution(Taquart::SolutionType AType,
+    std::list<Taquart::FaultSolution> &ASolution) {
+  ASolution.push_back(Solution[int(AType)]);
+}
+
+//---------------------------------------------------------------------------
+void Taquart::UsmtCore::TransferSolution(Taquart::SolutionType AType,
+    Taquart::FaultSolution &ASolution) {
+  ASolution = Solution[int(AType)];
+}
+
+//---------------------------------------------------------------------------
+void Taquart::UsmtCore::TransferAmplitudes(std::vector<double> &UTh) const {
+  UTh.resize(NUTH);
+  for (int i = 1; i <= NUTH; i++)
+    UTh[i - 1] = UTH[i];
+}
+
+//---------------------------------------------------------------------------
+namespace {
+  // Context shared by the non-reentrant USMTCore/TransferSolution functions.
+  Taquart::UsmtCore DefaultCore;
+}
+
+//---------------------------------------------------------------------------
+void TransferSolution(Taquart::SolutionType AType,
+    std::list<Taquart::FaultSolution> &ASolution) {
+  DefaultCore.TransferSolution(AType, ASolution);
+}
+
+//---------------------------------------------------------------------------
+void TransferSolution(Taquart::SolutionType AType,
+    Taquart::FaultSolution &ASolution) {
+  DefaultCore.TransferSolution(AType, ASolution);
+}
+
+//---------------------------------------------------------------------------
+void USMTCore(Taquart::NormType ANormType, int QualityType,
+    Taquart::SMTInputData &InputData, int * const AThreadProgress) {
+  DefaultCore.Run(ANormType, QualityType, InputData, AThreadProgress);
+}
+
+//---------------------------------------------------------------------------
+void Taquart::UsmtCore::MOM1(int &IEXP, int QualityType, bool EXACT) {
   //      SUBROUTINE MOM1(IEXP)
   //      CHARACTER PS(80),TITLE*40
   //      REAL U(80),ARR(80),AZM(80),TKF(80),LLA(3),HA(2)
@@ -84,8 +398,8 @@ void Taquart::UsmtCore::MOM1(int &IEXP, int QualityType) {
   //      COMMON/PDATA/ A(80,6)
   //      DIMENSION EQM(3),AA(80,6),B(6),H(5),IW(80),PA(3),BB(6)
   //      REAL RM0(3),RMT(3),PCLVD(2),PDBCP(2)
-  double AA[MAXCHANNEL + 1][6 + 1];
-  unsigned int IW[MAXCHANNEL + 1];
+  Taquart::ChannelMatrix<double, 6 + 1> AA(N);
+  std::vector<unsigned int> IW(N + 1);
   double PA[3 + 1];
   Zero(PA, 4);
   double EQM[3 + 1];
@@ -223,7 +537,20 @@ void Taquart::UsmtCore::MOM1(int &IEXP, int QualityType) {
   //      CALL GSOL(B,iexp)
   //C     Find and sort eigenvalues:
   //      CALL EIG3(B,0,EQM)
-  GSOL(B, IEXP);
+  // EXACT: the full and trace-null problems are solved by L1LP, the grid
+  // search remains the fallback and is always used for the double-couple.
+  // A is now the design matrix of the L1 problem.
+  GEOREADY = false;
+  L1MATRX();
+  L1Levels[1] = L1Levels[2] = 0;
+  L1Points[1] = L1Points[2] = 0.0;
+  L1Pruned[1] = L1Pruned[2] = 0.0;
+  L1Visits[1] = L1Visits[2] = 0.0;
+  double TIME0 = WallTime();
+  L1Exact[1] = EXACT && L1LP(6, AT, B);
+  if (!L1Exact[1]) GSOL(B, IEXP);
+  L1Time = WallTime() - TIME0;
+  f1(B, L1Misfit[1]);
   EIG3(B, 0, EQM);
 
   //      EQQ1=EQM(1)
@@ -407,7 +734,11 @@ void Taquart::UsmtCore::MOM1(int &IEXP, int QualityType) {
   //      DO 55 I=1,5
   //   55 RM(I,2)=H(I)
   //      RM(6,2)=-RM(1,2)-RM(4,2)
-  GSOL5(H, IEXP);
+  TIME0 = WallTime();
+  L1Exact[2] = EXACT && L1LP(5, HT, H);
+  if (!L1Exact[2]) GSOL5(H, IEXP);
+  L1Time = L1Time + WallTime() - TIME0;
+  f2(H, L1Misfit[2]);
   for (int i = 1; i <= 5; i++)
     RM[i][2] = H[i];
   RM[6][2] = -RM[1][2] - RM[4][2];
@@ -585,10 +916,16 @@ void Taquart::UsmtCore::MOM1(int &IEXP, int QualityType) {
   //      DO 3055 I=1,5
   // 3055 RM(I,3)=H(I)
   //      RM(6,3)=-RM(1,3)-RM(4,3)
-  GSOLA(H, IEXP);
-  for (int i = 1; i <= 5; i++)
-    RM[i][3] = H[i];
-  RM[6][3] = -RM[1][3] - RM[4][3];
+  if (DCGridStep > 0.0) {
+    double HELP = 0.0;
+    GRIDDC(1, 1.0, HELP);
+  }
+  else {
+    GSOLA(H, IEXP);
+    for (int i = 1; i <= 5; i++)
+      RM[i][3] = H[i];
+    RM[6][3] = -RM[1][3] - RM[4][3];
+  }
 
   //C     Finds scalar seismic moment:
   //      DO 3009 I=1,6
@@ -745,6 +1082,8 @@ void Taquart::UsmtCore::MOM1(int &IEXP, int QualityType) {
     Solution[i].CLVD = PCLVD[i];
     Solution[i].DBCP = PDBCP[i];
     Solution[i].MAGN = MAGN[i];
+    Solution[i].DCIterations = 0;
+    Solution[i].DCConverged = true;
     for (int m = 1; m <= 6; m++)
       for (int n = 1; n <= 6; n++)
         Solution[i].Covariance[m][n] = 0.0;
@@ -775,6 +1114,12 @@ void Taquart::UsmtCore::EIG3(double RM[], int ISTER, double E[]) {
   double F = 0.0, G = 0.0, OX = 0.0, FF = 0.0, FG = 0.0, QX = 0.0, HELP = 0.0;
   double FX = 0.0;
 
+  // The closed-form eigenvalues need no refinement (ISTER).
+  if (ClosedFormEigen) {
+    EIG3CF(RM, E);
+    return;
+  }
+
   //      DO 1 I=1,6
   //    1 Q(I)=DBLE(RM(I))
   for (int i = 1; i <= 6; i++)
@@ -927,6 +1272,123 @@ void Taquart::UsmtCore::EIG3(double RM[], int ISTER, double E[]) {
   //      END
 }
 
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::EIG3CF(const double Q[], double E[]) {
+  // Eigenvalues of the symmetric tensor Q (Q(1)=M11, Q(2)=M12, Q(3)=M13,
+  // Q(4)=M22, Q(5)=M23, Q(6)=M33) from the trigonometric solution of the
+  // characteristic equation. The root farthest from the other two is then
+  // refined by a Newton step and the other two follow from the quadratic
+  // left after its removal, as in EIG3, so close or equal eigenvalues stay
+  // accurate. E(1) is the refined root, E(2).LE.E(3).
+  const double PI = 4.0 * atan(1.0);
+  const double QM = (Q[1] + Q[4] + Q[6]) / 3.0;
+  const double B1 = Q[1] - QM, B4 = Q[4] - QM, B6 = Q[6] - QM;
+  const double P1 = Q[2] * Q[2] + Q[3] * Q[3] + Q[5] * Q[5];
+  const double P2 = B1 * B1 + B4 * B4 + B6 * B6 + 2.0 * P1;
+  if (P2 == 0.0) {
+    E[1] = E[2] = E[3] = QM;
+    return;
+  }
+  const double P = sqrt(P2 / 6.0);
+  const double DET = B1 * (B4 * B6 - Q[5] * Q[5])
+      - Q[2] * (Q[2] * B6 - Q[5] * Q[3]) + Q[3] * (Q[2] * Q[5] - B4 * Q[3]);
+  double R = DET / (2.0 * P * P * P);
+  if (R > 1.0) R = 1.0;
+  if (R < -1.0) R = -1.0;
+  const double PHI = acos(R) / 3.0;
+  double X = (R >= 0.0) ? QM + 2.0 * P * cos(PHI) :
+      QM + 2.0 * P * cos(PHI + 2.0 * PI / 3.0);
+
+  const double A2 = -(Q[1] + Q[4] + Q[6]);
+  const double A1 = Q[1] * Q[6] + Q[4] * Q[6] + Q[1] * Q[4] - Q[2] * Q[2]
+      - Q[3] * Q[3] - Q[5] * Q[5];
+  const double A0 = -2.0 * Q[2] * Q[3] * Q[5] - Q[1] * Q[4] * Q[6]
+      + Q[3] * Q[3] * Q[4] + Q[2] * Q[2] * Q[6] + Q[5] * Q[5] * Q[1];
+  const double DF = (3.0 * X + 2.0 * A2) * X + A1;
+  if (DF != 0.0) X = X - (((X + A2) * X + A1) * X + A0) / DF;
+
+  // Roots of X**2+C1*X+C0 without cancellation.
+  const double C0 = A1 + A2 * X + X * X;
+  const double C1 = A2 + X;
+  double D = C1 * C1 - 4.0 * C0;
+  if (D < 0.0) D = 0.0;
+  const double T = -0.5 * (C1 + (C1 >= 0.0 ? sqrt(D) : -sqrt(D)));
+  double Y1 = T, Y2 = (T != 0.0) ? C0 / T : 0.0;
+  if (Y1 > Y2) {
+    const double HELP = Y1;
+    Y1 = Y2;
+    Y2 = HELP;
+  }
+  E[1] = X;
+  E[2] = Y1;
+  E[3] = Y2;
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::EIGVCF(const double Q[], double EV, double V[]) {
+  // Unit eigenvector of the symmetric tensor Q (see EIG3CF) for the
+  // eigenvalue EV: the largest cross product of two rows of Q-EV*I. If EV is
+  // a double eigenvalue any unit vector orthogonal to the largest row is
+  // returned, and (0,0,1) for a triple one.
+  const double R[3 + 1][3 + 1] = { { 0.0, 0.0, 0.0, 0.0 },
+      { 0.0, Q[1] - EV, Q[2], Q[3] }, { 0.0, Q[2], Q[4] - EV, Q[5] },
+      { 0.0, Q[3], Q[5], Q[6] - EV } };
+  const int PAIR[3 + 1][2] = { { 0, 0 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
+  double C[3 + 1] = { 0.0, 0.0, 0.0, 0.0 };
+  double CMAX = 0.0, RMAX = 0.0;
+  int IR = 1;
+  V[1] = 0.0;
+  V[2] = 0.0;
+  V[3] = 1.0;
+  for (int k = 1; k <= 3; k++) {
+    const double * a = R[PAIR[k][0]];
+    const double * b = R[PAIR[k][1]];
+    const double X = a[2] * b[3] - a[3] * b[2];
+    const double Y = a[3] * b[1] - a[1] * b[3];
+    const double Z = a[1] * b[2] - a[2] * b[1];
+    const double HELP = X * X + Y * Y + Z * Z;
+    if (HELP > CMAX) {
+      CMAX = HELP;
+      C[1] = X;
+      C[2] = Y;
+      C[3] = Z;
+    }
+    const double RN = R[k][1] * R[k][1] + R[k][2] * R[k][2]
+        + R[k][3] * R[k][3];
+    if (RN > RMAX) {
+      RMAX = RN;
+      IR = k;
+    }
+  }
+  double SCALE = 0.0;
+  for (int i = 1; i <= 6; i++)
+    if (fabs(Q[i]) > SCALE) SCALE = fabs(Q[i]);
+  if (fabs(EV) > SCALE) SCALE = fabs(EV);
+  if (RMAX <= 1.0e-24 * SCALE * SCALE) return;
+  if (CMAX <= 1.0e-20 * RMAX * RMAX) {
+    // Double eigenvalue: a vector orthogonal to the largest row.
+    const double * a = R[IR];
+    if (fabs(a[1]) <= fabs(a[2]) && fabs(a[1]) <= fabs(a[3])) {
+      C[1] = 0.0;
+      C[2] = a[3];
+      C[3] = -a[2];
+    }
+    else if (fabs(a[2]) <= fabs(a[3])) {
+      C[1] = -a[3];
+      C[2] = 0.0;
+      C[3] = a[1];
+    }
+    else {
+      C[1] = a[2];
+      C[2] = -a[1];
+      C[3] = 0.0;
+    }
+  }
+  const double NORM = sqrt(C[1] * C[1] + C[2] * C[2] + C[3] * C[3]);
+  for (int i = 1; i <= 3; i++)
+    V[i] = C[i] / NORM;
+}
+
 /*
  disp('skladowe tensora liczone wedlug Jost and Herrmann, 1989');
  W=eig(M);
@@ -1082,8 +1544,8 @@ void Taquart::UsmtCore::XTRINF(int &ICOND, int LNORM, double Moment0[],
   //      PI=4.*ATAN(1.)
   double SQR2 = sqrt(2.0);
   double PI = 4.0 * atan(1.0);
-  double B[6];
-  Zero(B, 6);
+  double B[6 + 1];
+  Zero(B, 7);
   double V[4][4][4];
   Zero(&V[0][0][0], 64);
   double EQM[4];
@@ -1106,6 +1568,7 @@ void Taquart::UsmtCore::XTRINF(int &ICOND, int LNORM, double Moment0[],
 
   String INFO[4] = { "", "Normal fault", "Strike fault", "Reverse fault" };
   String INFFTD[4];
+  int JFTD[4] = { 0, 0, 0, 0 };
 
   double ETA[4];
   double HELP = 0, HELP1 = 0.0, HELP2 = 0.0, HELP3 = 0.0;
@@ -1214,6 +1677,26 @@ void Taquart::UsmtCore::XTRINF(int &ICOND, int LNORM, double Moment0[],
     EQM[2] = HELP2;
     EQM[3] = HELP3;
 
+    // Closed form: P and T axes from EIGVCF, the null axis orthogonal to
+    // both, signed as below.
+    if (ClosedFormEigen) {
+      double VV[3 + 1][3 + 1];
+      EIGVCF(B, EQM[1], VV[1]);
+      EIGVCF(B, EQM[3], VV[3]);
+      VV[2][1] = VV[3][2] * VV[1][3] - VV[3][3] * VV[1][2];
+      VV[2][2] = VV[3][3] * VV[1][1] - VV[3][1] * VV[1][3];
+      VV[2][3] = VV[3][1] * VV[1][2] - VV[3][2] * VV[1][1];
+      for (int j = 1; j <= 3; j++) {
+        HELP1 = sqrt(VV[j][1] * VV[j][1] + VV[j][2] * VV[j][2]
+            + VV[j][3] * VV[j][3]);
+        if (HELP1 == 0.0) VV[j][3] = HELP1 = 1.0;
+        if (VV[j][3] < 0.0) HELP1 = -1.0 * HELP1;
+        for (int k = 1; k <= 3; k++)
+          V[k][j][i] = VV[j][k] / HELP1;
+      }
+      continue;
+    }
+
     //      DO 13 J=1,3
     //      B(1)=B(1)-EQM(J)
     //      B(4)=B(4)-EQM(J)
@@ -1339,6 +1822,7 @@ void Taquart::UsmtCore::XTRINF(int &ICOND, int LNORM, double Moment0[],
     }
     if (PLUNGE[3][i] > HELP1) j = 3;
     INFFTD[i] = INFO[j];
+    JFTD[i] = j;
 
     if (PLUNGE[3][i] > PLUNGE[1][i]) {
       FaultType[i] = 1.0;
@@ -1549,7 +2033,7 @@ void Taquart::UsmtCore::XTRINF(int &ICOND, int LNORM, double Moment0[],
     Solution[i].BXPL = PLUNGE[2][i];
     Solution[i].BXAM = AMP[2][i];
     Solution[i].QI = ETA[i];
-    Solution[i].Type = INFFTD[i];
+    Solution[i].Type = Taquart::FaultType(JFTD[i]);
   }
 
   //   37 FORMAT(12X,15HQuality index =,F6.1,2X,A13,8X)
@@ -1571,7 +2055,7 @@ void Taquart::UsmtCore::XTRINF(int &ICOND, int LNORM, double Moment0[],
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
-void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
+void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType, bool PRESOLVED) {
   //      SUBROUTINE MOM2(REALLY)
   //      CHARACTER PS(80),TITLE*40
   //      REAL U(80),ARR(80),AZM(80),TKF(80),A(80,6),ATA(6,6),
@@ -1587,9 +2071,6 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
   //      COMMON/VCOVAR/ COV
   //      LOGICAL REALLY
 
-  //      PI=4.*ATAN(1.)
-  double PI = 4.0 * atan(1.0);
-  int IW[MAXCHANNEL + 1];
   double PA[3 + 1];
   Zero(&PA[0], 4);
   double ATA[6 + 1][6 + 1];
@@ -1618,18 +2099,14 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
   double EPS = 0.0;
   double SAI22 = 0.0;
   double SIG = 0.0;
-  double AA[MAXCHANNEL + 1][6 + 1];
-  Zero(&AA[0][0], (MAXCHANNEL + 1) * 7);
+  Taquart::ChannelMatrix<double, 6 + 1> AA(N);
   double DUM = 0.0;
-  double H[MAXCHANNEL + 1][5 + 1];
-  Zero(&H[0][0], (MAXCHANNEL + 1) * 6);
+  Taquart::ChannelMatrix<double, 5 + 1> H(N);
   double RMX = 0.0, RMY = 0.0, RMZ = 0.0;
   double RMAG = 0.0;
   double PEXPL[4], PCLVD[3 + 1], PDBCP[3 + 1];
-  double ALF = 0.0;
   ;
   double MAGN[4];
-  double HELP = 0.0;
   //double SVANG = 0.0;
   //double SKAL = 0.0;
   double LLA[4];
@@ -1638,167 +2115,72 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
   Zero(HA, 4);
 
   //      DO 3 I=1,N
-  for (int i = 1; i <= N; i++) {
-    //      IW(I)=0
-    //      IF((PS(I).EQ.'S').OR.(PS(I).EQ.'s')) IW(I)=1
-    //      IF((PS(I).EQ.'H').OR.(PS(I).EQ.'h')) IW(I)=2
-    IW[i] = 0;
-    //if(PS[i] == 'S' || PS[i] == 's') IW[i] = 1;
-    //if(PS[i] == 'H' || PS[i] == 'h') IW[i] = 2;
-
-    //      ALF=FLOAT(VEL(I))
-    //      HELP=4.*PI*FLOAT(RO(I))*ALF*ALF*ALF*FLOAT(R(I))*TROZ*1.E-12
-    ALF = VEL[i];
-
-    /* DONE  5 -c2.4.14 : Problem z kalibracj (USMTCORE) */
-    HELP = 4.0 * PI * double(RO[i]) * ALF * ALF * ALF * double(R[i]) * 1.0e-12;
-
-    //      IF(IW(I).NE.0) GO TO 5
-    if (IW[i] == 0) {
-      //C     For P:
-      //      A(I,1)=GA(I,1)*GA(I,1)/HELP
-      //      A(I,2)=2.*GA(I,1)*GA(I,2)/HELP
-      //      A(I,3)=2.*GA(I,1)*GA(I,3)/HELP
-      //      A(I,4)=GA(I,2)*GA(I,2)/HELP
-      //      A(I,5)=2.*GA(I,2)*GA(I,3)/HELP
-      //      A(I,6)=GA(I,3)*GA(I,3)/HELP
-      //      GO TO 3
-      A[i][1] = GA[i][1] * GA[i][1] / HELP;
-      A[i][2] = 2.0 * GA[i][1] * GA[i][2] / HELP;
-      A[i][3] = 2.0 * GA[i][1] * GA[i][3] / HELP;
-      A[i][4] = GA[i][2] * GA[i][2] / HELP;
-      A[i][5] = 2. * GA[i][2] * GA[i][3] / HELP;
-      A[i][6] = GA[i][3] * GA[i][3] / HELP;
-    }
-    /* TODO -o3.1.19 : Code for SV and SH is switched off by default. */
-    /*
-     else
-     {
-     //C     For SV:
-     //    5 SVANG=REAL(ARR(I))*PI/180.
-     //      PA(3)=-SIN(SVANG)
-     //      SKAL=-COS(SVANG)/SQRT(GA(I,1)*GA(I,1)+GA(I,2)*GA(I,2))
-     //      PA(1)=GA(I,1)*SKAL
-     //      PA(2)=GA(I,2)*SKAL
-     SVANG = double(ARR[i]) * PI / 180.0;
-     PA[3] = -sin(SVANG);
-     SKAL = -cos(SVANG) / sqrt(GA[i][1] * GA[i][1] + GA[i][2] * GA[i][2]);
-     PA[1] = GA[i][1] * SKAL;
-     PA[2] = GA[i][2] * SKAL;
-
-     //      IF(IW(I).EQ.2) GO TO 6
-     if(IW[i] != 2)
-     {
-     //      A(I,1)=GA(I,1)*PA(1)/HELP
-     //      A(I,2)=(GA(I,1)*PA(2)+GA(I,2)*PA(1))/HELP
-     //      A(I,3)=(GA(I,1)*PA(3)+GA(I,3)*PA(1))/HELP
-     //      A(I,4)=GA(I,2)*PA(2)/HELP
-     //      A(I,5)=(GA(I,2)*PA(3)+GA(I,3)*PA(2))/HELP
-     //      A(I,6)=GA(I,3)*PA(3)/HELP
-     //      GO TO 3
-     A[i][1]=GA[i][1]*PA[1]/HELP;
-     A[i][2]=(GA[i][1]*PA[2]+GA[i][2]*PA[1])/HELP;
-     A[i][3]=(GA[i][1]*PA[3]+GA[i][3]*PA[1])/HELP;
-     A[i][4]=GA[i][2]*PA[2]/HELP;
-     A[i][5]=(GA[i][2]*PA[3]+GA[i][3]*PA[2])/HELP;
-     A[i][6]=GA[i][3]*PA[3]/HELP;
-     }
-     else
-     {
-     //C     For SH:
-     //    6 LLA(3)=-COS(SVANG)
-     //      SKAL=SIN(SVANG)/SQRT(GA(I,1)*GA(I,1)+GA(I,2)*GA(I,2))
-     //      LLA(1)=GA(I,1)*SKAL
-     //      LLA(2)=GA(I,2)*SKAL
-     //      HA(1)=LLA(2)*PA(3)-LLA(3)*PA(2)
-     //      HA(2)=-LLA(1)*PA(3)+LLA(3)*PA(1)
-     //      A(I,1)=GA(I,1)*HA(1)/HELP+LLA(3)*GA(I,1)*PA(1)/HELP
-     //      A(I,2)=(GA(I,1)*HA(2)+GA(I,2)*HA(1))/HELP
-     //     $+LLA(3)*(GA(I,1)*PA(2)+GA(I,2)*PA(1))/HELP
-     //      A(I,3)=GA(I,3)*HA(1)/HELP+LLA(3)*(GA(I,1)*PA(3)+GA(I,3)*PA(1))
-     //     $/HELP
-     //      A(I,4)=GA(I,2)*HA(2)/HELP+LLA(3)*GA(I,2)*PA(2)/HELP
-     //      A(I,5)=GA(I,3)*HA(2)/HELP+LLA(3)*(GA(I,2)*PA(3)+GA(I,3)*PA(2))
-     //     $/HELP
-     //      A(I,6)=+LLA(3)*GA(I,3)*PA(3)/HELP
-
-     LLA[3]=-cos(SVANG);
-     SKAL = sin(SVANG)/sqrt(GA[i][1]*GA[i][1]+GA[i][2]*GA[i][2]);
-     LLA[1]=GA[i][1]*SKAL;
-     LLA[2]=GA[i][2]*SKAL;
-     HA[1]=LLA[2]*PA[3]-LLA[3]*PA[2];
-     HA[2]=-LLA[1]*PA[3]+LLA[3]*PA[1];
-     A[i][1]=GA[i][1]*HA[1]/HELP+LLA[3]*GA[i][1]*PA[1]/HELP;
-     A[i][2]=(GA[i][1]*HA[2]+GA[i][2]*HA[1])/HELP+LLA[3]*(GA[i][1]*PA[2]+GA[i][2]*PA[1])/HELP;
-     A[i][3]=GA[i][3]*HA[1]/HELP+LLA[3]*(GA[i][1]*PA[3]+GA[i][3]*PA[1])/HELP;
-     A[i][4]=GA[i][2]*HA[2]/HELP+LLA[3]*GA[i][2]*PA[2]/HELP;
-     A[i][5]=GA[i][3]*HA[2]/HELP+LLA[3]*(GA[i][2]*PA[3]+GA[i][3]*PA[2])/HELP;
-     A[i][6]=+LLA[3]*GA[i][3]*PA[3]/HELP;
-     }
-     }
-     */
-  }
+  //      ...
   //    3 CONTINUE
+  if (!PRESOLVED && !GEOREADY) AMATRX();
 
   //      IF(.NOT.REALLY) GO TO 1011
   if (REALLY) {
     //C     #################### FULL TENSOR PART:
     //C     Solve equation AM=U for M:
-    //      DO 101 I=1,6
-    //      DO 101 J=1,6
-    //      ATA(I,J)=0.
-    //      DO 101 K=1,N
-    //  101 ATA(I,J)=ATA(I,J)+A(K,J)*A(K,I)
-    for (int i = 1; i <= 6; i++) {
-      for (int j = 1; j <= 6; j++) {
-        ATA[i][j] = 0.0;
-        for (int k = 1; k <= N; k++)
-          ATA[i][j] = ATA[i][j] + A[k][j] * A[k][i];
+    // The solution is already in RM(I,1) when the L2 batch is used.
+    if (!PRESOLVED) {
+      //      DO 101 I=1,6
+      //      DO 101 J=1,6
+      //      ATA(I,J)=0.
+      //      DO 101 K=1,N
+      //  101 ATA(I,J)=ATA(I,J)+A(K,J)*A(K,I)
+      for (int i = 1; i <= 6; i++) {
+        for (int j = 1; j <= 6; j++) {
+          ATA[i][j] = 0.0;
+          for (int k = 1; k <= N; k++)
+            ATA[i][j] = ATA[i][j] + A[k][j] * A[k][i];
+        }
       }
-    }
 
-    //      DO 1002 I=1,6
-    //      DO 1002 J=1,6
-    // 1002 Z1(I,J)=ATA(I,J)
-    for (int i = 1; i <= 6; i++) {
-      for (int j = 1; j <= 6; j++) {
-        Z1[i][j] = ATA[i][j];
+      //      DO 1002 I=1,6
+      //      DO 1002 J=1,6
+      // 1002 Z1(I,J)=ATA(I,J)
+      for (int i = 1; i <= 6; i++) {
+        for (int j = 1; j <= 6; j++) {
+          Z1[i][j] = ATA[i][j];
+        }
       }
-    }
 
-    //      CALL INVMAT(Z1,Z2,6)
-    INVMAT(Z1, Z2, 6);
+      //      CALL INVMAT(Z1,Z2,6)
+      INVMAT(Z1, Z2, 6);
 
-    //      DO 1001 I=1,6
-    //      DO 1001 J=1,6
-    // 1001 ATAINV(I,J)=Z2(I,J)
-    for (int i = 1; i <= 6; i++) {
-      for (int j = 1; j <= 6; j++) {
-        ATAINV[i][j] = Z2[i][j];
+      //      DO 1001 I=1,6
+      //      DO 1001 J=1,6
+      // 1001 ATAINV(I,J)=Z2(I,J)
+      for (int i = 1; i <= 6; i++) {
+        for (int j = 1; j <= 6; j++) {
+          ATAINV[i][j] = Z2[i][j];
+        }
       }
-    }
 
-    //      DO 102 I=1,6
-    //      B(I)=0.
-    //      DO 102 J=1,N
-    //  102 B(I)=B(I)+A(J,I)*U(J)*1.E+12
-    for (int i = 1; i <= 6; i++) {
-      B[i] = 0.0;
-      for (int j = 1; j <= N; j++) {
-        B[i] = B[i] + A[j][i] * U[j] * 1.0e+12;
+      //      DO 102 I=1,6
+      //      B(I)=0.
+      //      DO 102 J=1,N
+      //  102 B(I)=B(I)+A(J,I)*U(J)*1.E+12
+      for (int i = 1; i <= 6; i++) {
+        B[i] = 0.0;
+        for (int j = 1; j <= N; j++) {
+          B[i] = B[i] + A[j][i] * U[j] * 1.0e+12;
+        }
       }
-    }
 
-    //      DO 103 I=1,6
-    //      RM(I,1)=0.
-    //      DO 103 J=1,6
-    //  103 RM(I,1)=RM(I,1)+ATAINV(I,J)*B(J)
-    for (int i = 1; i <= 6; i++) {
-      RM[i][1] = 0.0;
-      for (int j = 1; j <= 6; j++) {
-        RM[i][1] = RM[i][1] + ATAINV[i][j] * B[j];
+      //      DO 103 I=1,6
+      //      RM(I,1)=0.
+      //      DO 103 J=1,6
+      //  103 RM(I,1)=RM(I,1)+ATAINV(I,J)*B(J)
+      for (int i = 1; i <= 6; i++) {
+        RM[i][1] = 0.0;
+        for (int j = 1; j <= 6; j++) {
+          RM[i][1] = RM[i][1] + ATAINV[i][j] * B[j];
+        }
       }
-    }
+    } // if !PRESOLVED
 
     //C     Finds scalar seismic moment:
     //      DO 9 I=1,6
@@ -1969,76 +2351,79 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
 #endif
   } // if REALLY
 
-  // 1011 DO 55 I=1,N
-  //      H(I,1)=A(I,1)-A(I,6)
-  //      H(I,2)=A(I,2)
-  //      H(I,3)=A(I,3)
-  //      H(I,4)=A(I,4)-A(I,6)
-  //   55 H(I,5)=A(I,5)
-  for (int i = 1; i <= N; i++) {
-    H[i][1] = A[i][1] - A[i][6];
-    H[i][2] = A[i][2];
-    H[i][3] = A[i][3];
-    H[i][4] = A[i][4] - A[i][6];
-    H[i][5] = A[i][5];
-  }
+  // The trace-null solution is already in RM(I,2) when the L2 batch is used.
+  if (!PRESOLVED) {
+    // 1011 DO 55 I=1,N
+    //      H(I,1)=A(I,1)-A(I,6)
+    //      H(I,2)=A(I,2)
+    //      H(I,3)=A(I,3)
+    //      H(I,4)=A(I,4)-A(I,6)
+    //   55 H(I,5)=A(I,5)
+    for (int i = 1; i <= N; i++) {
+      H[i][1] = A[i][1] - A[i][6];
+      H[i][2] = A[i][2];
+      H[i][3] = A[i][3];
+      H[i][4] = A[i][4] - A[i][6];
+      H[i][5] = A[i][5];
+    }
 
-  //C     Solve equation HM=U for M:
-  //      DO 2101 I=1,5
-  //      DO 2101 J=1,5
-  //      ATA(I,J)=0.
-  //      DO 2101 K=1,N
-  // 2101 ATA(I,J)=ATA(I,J)+H(K,J)*H(K,I)
-  for (int i = 1; i <= 5; i++) {
-    for (int j = 1; j <= 5; j++) {
-      ATA[i][j] = 0.0;
-      for (int k = 1; k <= N; k++)
-        ATA[i][j] = ATA[i][j] + H[k][j] * H[k][i];
+    //C     Solve equation HM=U for M:
+    //      DO 2101 I=1,5
+    //      DO 2101 J=1,5
+    //      ATA(I,J)=0.
+    //      DO 2101 K=1,N
+    // 2101 ATA(I,J)=ATA(I,J)+H(K,J)*H(K,I)
+    for (int i = 1; i <= 5; i++) {
+      for (int j = 1; j <= 5; j++) {
+        ATA[i][j] = 0.0;
+        for (int k = 1; k <= N; k++)
+          ATA[i][j] = ATA[i][j] + H[k][j] * H[k][i];
+      }
     }
-  }
 
-  //      DO 1005 I=1,5
-  //      DO 1005 J=1,5
-  // 1005 Z1(I,J)=ATA(I,J)
-  for (int i = 1; i <= 5; i++) {
-    for (int j = 1; j <= 5; j++) {
-      Z1[i][j] = ATA[i][j];
+    //      DO 1005 I=1,5
+    //      DO 1005 J=1,5
+    // 1005 Z1(I,J)=ATA(I,J)
+    for (int i = 1; i <= 5; i++) {
+      for (int j = 1; j <= 5; j++) {
+        Z1[i][j] = ATA[i][j];
+      }
     }
-  }
 
-  //      CALL INVMAT(Z1,Z2,5)
-  INVMAT(Z1, Z2, 5);
+    //      CALL INVMAT(Z1,Z2,5)
+    INVMAT(Z1, Z2, 5);
 
-  //      DO 1004 I=1,5
-  //      DO 1004 J=1,5
-  // 1004 ATAINV(I,J)=Z2(I,J)
-  for (int i = 1; i <= 5; i++) {
-    for (int j = 1; j <= 5; j++) {
-      ATAINV[i][j] = Z2[i][j];
+    //      DO 1004 I=1,5
+    //      DO 1004 J=1,5
+    // 1004 ATAINV(I,J)=Z2(I,J)
+    for (int i = 1; i <= 5; i++) {
+      for (int j = 1; j <= 5; j++) {
+        ATAINV[i][j] = Z2[i][j];
+      }
     }
-  }
 
-  //      DO 2102 I=1,5
-  //      B(I)=0.
-  //      DO 2102 J=1,N
-  // 2102 B(I)=B(I)+H(J,I)*U(J)*1.E+12
-  for (int i = 1; i <= 5; i++) {
-    B[i] = 0.0;
-    for (int j = 1; j <= N; j++) {
-      B[i] = B[i] + H[j][i] * U[j] * 1.0e+12;
+    //      DO 2102 I=1,5
+    //      B(I)=0.
+    //      DO 2102 J=1,N
+    // 2102 B(I)=B(I)+H(J,I)*U(J)*1.E+12
+    for (int i = 1; i <= 5; i++) {
+      B[i] = 0.0;
+      for (int j = 1; j <= N; j++) {
+        B[i] = B[i] + H[j][i] * U[j] * 1.0e+12;
+      }
     }
-  }
 
-  //      DO 2103 I=1,5
-  //      RM(I,2)=0.
-  //      DO 2103 J=1,5
-  // 2103 RM(I,2)=RM(I,2)+ATAINV(I,J)*B(J)
-  for (int i = 1; i <= 5; i++) {
-    RM[i][2] = 0.0;
-    for (int j = 1; j <= 5; j++) {
-      RM[i][2] = RM[i][2] + ATAINV[i][j] * B[j];
+    //      DO 2103 I=1,5
+    //      RM(I,2)=0.
+    //      DO 2103 J=1,5
+    // 2103 RM(I,2)=RM(I,2)+ATAINV(I,J)*B(J)
+    for (int i = 1; i <= 5; i++) {
+      RM[i][2] = 0.0;
+      for (int j = 1; j <= 5; j++) {
+        RM[i][2] = RM[i][2] + ATAINV[i][j] * B[j];
+      }
     }
-  }
+  } // if !PRESOLVED
 
   //      RM(6,2)=-RM(1,2)-RM(4,2)
   RM[6][2] = -RM[1][2] - RM[4][2];
@@ -2204,7 +2589,7 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
   //      ISTER=1
   //      CALL FIJGEN
   //ISTER = 1;
-  FIJGEN();
+  if (!GEOREADY) FIJGEN();
 
   //      DO 1003 I=1,6
   // 1003 B(I)=RM(I,2)
@@ -2238,7 +2623,14 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
   if (EQM[3] != RMX && EQM[3] != RMY) RMZ = EQM[3];
 
   //      CALL BETTER(RMY,RMZ,RM0(3),RMT(3),ICOND)
-  BETTER(RMY, RMZ, RM0[3], RMT[3], ICOND);
+  if (DCGridStep > 0.0) {
+    GRIDDC(2, 1.0e-12, RM0[3]);
+    RMT[3] = RM0[3];
+    ICOND = 1;
+    DCITER = 0;
+  }
+  else
+    BETTER(RMY, RMZ, RM0[3], RMT[3], ICOND);
 
   //      DO 2003 I=1,6
   // 2003 B(I)=RM(I,3)
@@ -2373,26 +2765,9 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
 
   //---- Transfer data to Taquart::FaultSolution structures
 
-  // Theoretical displacement (taken from full solution, partially incorrect).
-  for (int i = 1; i <= N; i++) {
-    Solution[1].U_n = N;
-    Solution[2].U_n = N;
-    Solution[3].U_n = N;
-    Solution[1].U_th[i - 1] = UTH[i];
-    Solution[2].U_th[i - 1] = UTH[i];
-    Solution[3].U_th[i - 1] = UTH[i];
-    Solution[1].U_measured[i - 1] = U[i];
-    Solution[2].U_measured[i - 1] = U[i];
-    Solution[3].U_measured[i - 1] = U[i];
-    /*
-     Solution[1].U_th.push_back(UTH[i]);
-     Solution[2].U_th.push_back(UTH[i]);
-     Solution[3].U_th.push_back(UTH[i]);
-     Solution[1].U_measured.push_back(U[i]);
-     Solution[2].U_measured.push_back(U[i]);
-     Solution[3].U_measured.push_back(U[i]);
-     */
-  }
+  // Theoretical displacement (taken from full solution, partially incorrect)
+  // stays in UTH, see TransferAmplitudes.
+  NUTH = N;
 
   double uerr = 0.0;
   double umax = -1.0e300;
@@ -2425,6 +2800,8 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
     Solution[i].CLVD = PCLVD[i];
     Solution[i].DBCP = PDBCP[i];
     Solution[i].MAGN = MAGN[i];
+    Solution[i].DCIterations = (i == 3) ? DCITER : 0;
+    Solution[i].DCConverged = (i != 3 || ICOND == 1);
 
     for (int m = 1; m <= 6; m++)
       for (int n = 1; n <= 6; n++)
@@ -2440,103 +2817,634 @@ void Taquart::UsmtCore::MOM2(bool REALLY, int QualityType) {
 }
 
 //-----------------------------------------------------------------------------
-void Taquart::UsmtCore::INVMAT(double A[][10], double B[][10], int NP) {
-  //      SUBROUTINE INVMAT(A,B,NP)
-  //C     Routine inverts matrix A of dimensions 9*9
-  //      DIMENSION A(9,9),B(9,9),Y(9,9),ALU(9,9),INDX(9)
-  //      EXTERNAL LUDCMP,LUBKSB
+void Taquart::UsmtCore::AMATRX(void) {
+  // Design matrix of the L2 inversion (moved out of MOM2).
+  //      PI=4.*ATAN(1.)
+  double PI = 4.0 * atan(1.0);
+  std::vector<int> IW(N + 1);
+  double ALF = 0.0;
+  double HELP = 0.0;
 
-  double Y[10][10];
-  Zero(&Y[0][0], 100);
-  double ALU[10][10];
-  Zero(&ALU[0][0], 100);
-  int INDX[10];
-  for (int i = 0; i < 10; i++)
-    INDX[i] = 0;
-  double D = 0;
+  //      DO 3 I=1,N
+  for (int i = 1; i <= N; i++) {
+    //      IW(I)=0
+    //      IF((PS(I).EQ.'S').OR.(PS(I).EQ.'s')) IW(I)=1
+    //      IF((PS(I).EQ.'H').OR.(PS(I).EQ.'h')) IW(I)=2
+    IW[i] = 0;
+    //if(PS[i] == 'S' || PS[i] == 's') IW[i] = 1;
+    //if(PS[i] == 'H' || PS[i] == 'h') IW[i] = 2;
 
-  //      DO 12 I=1,NP
-  //       DO 11 J=1,NP
-  //        Y(I,J)=0.
-  //   11   CONTINUE
-  //       Y(I,I)=1.
-  //   12 CONTINUE
-  for (int i = 1; i <= NP; i++) {
-    for (int j = 1; j <= NP; j++) {
-      Y[i][j] = 0.0;
+    //      ALF=FLOAT(VEL(I))
+    //      HELP=4.*PI*FLOAT(RO(I))*ALF*ALF*ALF*FLOAT(R(I))*TROZ*1.E-12
+    ALF = VEL[i];
+
+    /* DONE  5 -c2.4.14 : Problem z kalibracj (USMTCORE) */
+    HELP = 4.0 * PI * double(RO[i]) * ALF * ALF * ALF * double(R[i]) * 1.0e-12;
+
+    //      IF(IW(I).NE.0) GO TO 5
+    if (IW[i] == 0) {
+      //C     For P:
+      //      A(I,1)=GA(I,1)*GA(I,1)/HELP
+      //      A(I,2)=2.*GA(I,1)*GA(I,2)/HELP
+      //      A(I,3)=2.*GA(I,1)*GA(I,3)/HELP
+      //      A(I,4)=GA(I,2)*GA(I,2)/HELP
+      //      A(I,5)=2.*GA(I,2)*GA(I,3)/HELP
+      //      A(I,6)=GA(I,3)*GA(I,3)/HELP
+      //      GO TO 3
+      A[i][1] = GA[i][1] * GA[i][1] / HELP;
+      A[i][2] = 2.0 * GA[i][1] * GA[i][2] / HELP;
+      A[i][3] = 2.0 * GA[i][1] * GA[i][3] / HELP;
+      A[i][4] = GA[i][2] * GA[i][2] / HELP;
+      A[i][5] = 2. * GA[i][2] * GA[i][3] / HELP;
+      A[i][6] = GA[i][3] * GA[i][3] / HELP;
     }
-    Y[i][i] = 1.0;
-  }
+    /* TODO -o3.1.19 : Code for SV and SH is switched off by default. */
+    /*
+     else
+     {
+     //C     For SV:
+     //    5 SVANG=REAL(ARR(I))*PI/180.
+     //      PA(3)=-SIN(SVANG)
+     //      SKAL=-COS(SVANG)/SQRT(GA(I,1)*GA(I,1)+GA(I,2)*GA(I,2))
+     //      PA(1)=GA(I,1)*SKAL
+     //      PA(2)=GA(I,2)*SKAL
+     SVANG = double(ARR[i]) * PI / 180.0;
+     PA[3] = -sin(SVANG);
+     SKAL = -cos(SVANG) / sqrt(GA[i][1] * GA[i][1] + GA[i][2] * GA[i][2]);
+     PA[1] = GA[i][1] * SKAL;
+     PA[2] = GA[i][2] * SKAL;
 
-  //      CALL LUDCMP(A,ALU,INDX,D,NP)
-  LUDCMP(A, ALU, INDX, D, NP);
+     //      IF(IW(I).EQ.2) GO TO 6
+     if(IW[i] != 2)
+     {
+     //      A(I,1)=GA(I,1)*PA(1)/HELP
+     //      A(I,2)=(GA(I,1)*PA(2)+GA(I,2)*PA(1))/HELP
+     //      A(I,3)=(GA(I,1)*PA(3)+GA(I,3)*PA(1))/HELP
+     //      A(I,4)=GA(I,2)*PA(2)/HELP
+     //      A(I,5)=(GA(I,2)*PA(3)+GA(I,3)*PA(2))/HELP
+     //      A(I,6)=GA(I,3)*PA(3)/HELP
+     //      GO TO 3
+     A[i][1]=GA[i][1]*PA[1]/HELP;
+     A[i][2]=(GA[i][1]*PA[2]+GA[i][2]*PA[1])/HELP;
+     A[i][3]=(GA[i][1]*PA[3]+GA[i][3]*PA[1])/HELP;
+     A[i][4]=GA[i][2]*PA[2]/HELP;
+     A[i][5]=(GA[i][2]*PA[3]+GA[i][3]*PA[2])/HELP;
+     A[i][6]=GA[i][3]*PA[3]/HELP;
+     }
+     else
+     {
+     //C     For SH:
+     //    6 LLA(3)=-COS(SVANG)
+     //      SKAL=SIN(SVANG)/SQRT(GA(I,1)*GA(I,1)+GA(I,2)*GA(I,2))
+     //      LLA(1)=GA(I,1)*SKAL
+     //      LLA(2)=GA(I,2)*SKAL
+     //      HA(1)=LLA(2)*PA(3)-LLA(3)*PA(2)
+     //      HA(2)=-LLA(1)*PA(3)+LLA(3)*PA(1)
+     //      A(I,1)=GA(I,1)*HA(1)/HELP+LLA(3)*GA(I,1)*PA(1)/HELP
+     //      A(I,2)=(GA(I,1)*HA(2)+GA(I,2)*HA(1))/HELP
+     //     $+LLA(3)*(GA(I,1)*PA(2)+GA(I,2)*PA(1))/HELP
+     //      A(I,3)=GA(I,3)*HA(1)/HELP+LLA(3)*(GA(I,1)*PA(3)+GA(I,3)*PA(1))
+     //     $/HELP
+     //      A(I,4)=GA(I,2)*HA(2)/HELP+LLA(3)*GA(I,2)*PA(2)/HELP
+     //      A(I,5)=GA(I,3)*HA(2)/HELP+LLA(3)*(GA(I,2)*PA(3)+GA(I,3)*PA(2))
+     //     $/HELP
+     //      A(I,6)=+LLA(3)*GA(I,3)*PA(3)/HELP
 
-  //      DO 13 J=1,NP
-  //       CALL LUBKSB(ALU,INDX,Y(1,J),B(1,J),NP)
-  //   13  CONTINUE
-  for (int j = 1; j <= NP; j++) {
-    LUBKSB2(ALU, INDX, Y, B, NP, j);
+     LLA[3]=-cos(SVANG);
+     SKAL = sin(SVANG)/sqrt(GA[i][1]*GA[i][1]+GA[i][2]*GA[i][2]);
+     LLA[1]=GA[i][1]*SKAL;
+     LLA[2]=GA[i][2]*SKAL;
+     HA[1]=LLA[2]*PA[3]-LLA[3]*PA[2];
+     HA[2]=-LLA[1]*PA[3]+LLA[3]*PA[1];
+     A[i][1]=GA[i][1]*HA[1]/HELP+LLA[3]*GA[i][1]*PA[1]/HELP;
+     A[i][2]=(GA[i][1]*HA[2]+GA[i][2]*HA[1])/HELP+LLA[3]*(GA[i][1]*PA[2]+GA[i][2]*PA[1])/HELP;
+     A[i][3]=GA[i][3]*HA[1]/HELP+LLA[3]*(GA[i][1]*PA[3]+GA[i][3]*PA[1])/HELP;
+     A[i][4]=GA[i][2]*HA[2]/HELP+LLA[3]*GA[i][2]*PA[2]/HELP;
+     A[i][5]=GA[i][3]*HA[2]/HELP+LLA[3]*(GA[i][2]*PA[3]+GA[i][3]*PA[2])/HELP;
+     A[i][6]=+LLA[3]*GA[i][3]*PA[3]/HELP;
+     }
+     }
+     */
   }
-
-  //      RETURN
-  //      END
+  //    3 CONTINUE
 }
 
 //-----------------------------------------------------------------------------
-void Taquart::UsmtCore::LUBKSB2(double A[][10], int INDX[], double C[][10],
-    double B[][10], int &NP, int jj) {
-  //      SUBROUTINE LUBKSB(A,INDX,C,B,NP)
-  //C     Routine solves set of linear equations AX=B. Matrix A is input as its
-  //C     LU decomposition. INDX is permutation vector. C is input as right-hand
-  //C     side vector and solution is returned as B. A, and INDX are not modified.
-  //      DIMENSION A(9,9),INDX(9),B(9),C(9)
-
-  //      DO 1 I=1,NP
-  //    1  B(I)=C(I)
-  for (int i = 1; i <= NP; i++)
-    B[i][jj] = C[i][jj];
-
-  //      II=0
-  int II = 0;
-
-  //      DO 12 I=1,NP
-  for (int i = 1; i <= NP; i++) {
-    //       LL=INDX(I)
-    //       SUM=B(LL)
-    //       B(LL)=B(I)
-    int LL = INDX[i];
-    double SUM = B[LL][jj];
-    B[LL][jj] = B[i][jj];
+void Taquart::UsmtCore::PSINV(void) {
+  // Pseudo-inverses (ATA)**(-1)*AT of the full (PINV(I,J,1)) and trace-null
+  // (PINV(I,J,2)) problems, scaled like the right-hand side in MOM2. The
+  // inverted normal matrices are kept in NINV(I,J,1) and NINV(I,J,2).
+  double ATA[6 + 1][6 + 1];
+  double Z1[9 + 1][9 + 1];
+  double Z2[9 + 1][9 + 1];
+  Taquart::ChannelMatrix<double, 5 + 1> H(N);
+  Zero(&Z1[0][0], 100);
+  Zero(&Z2[0][0], 100);
 
-    //       IF(II.NE.0) THEN
-    if (II != 0) {
-      //        DO 11 J=II,I-1
-      //         SUM=SUM-A(I,J)*B(J)
-      //   11    CONTINUE
-      for (int j = II; j <= i - 1; j++)
-        SUM = SUM - A[i][j] * B[j][jj];
+  for (int i = 1; i <= 6; i++)
+    for (int j = 1; j <= 6; j++) {
+      ATA[i][j] = 0.0;
+      for (int k = 1; k <= N; k++)
+        ATA[i][j] = ATA[i][j] + A[k][j] * A[k][i];
+      Z1[i][j] = ATA[i][j];
     }
-    //        ELSE IF(SUM.NE.0.) THEN
-    else if (SUM != 0.0) {
-      //         II=I
-      II = i;
+  INVMAT(Z1, Z2, 6);
+  for (int i = 1; i <= 6; i++)
+    for (int j = 1; j <= 6; j++)
+      NINV[i][j][1] = Z2[i][j];
+  for (int i = 1; i <= 6; i++)
+    for (int j = 1; j <= N; j++) {
+      PINV[i][j][1] = 0.0;
+      for (int k = 1; k <= 6; k++)
+        PINV[i][j][1] = PINV[i][j][1] + Z2[i][k] * A[j][k] * 1.0e+12;
     }
-    //        ENDIF
-    //       B(I)=SUM
-    B[i][jj] = SUM;
-  }
-  //   12  CONTINUE
 
-  //      DO 14 I=NP,1,-1
-  for (int i = NP; i >= 1; i--) {
-    //       SUM=B(I)
-    double SUM = B[i][jj];
-    //       IF(I.LT.NP) THEN
-    if (i < NP) {
-      //        DO 13 J=I+1,NP
-      //         SUM=SUM-A(I,J)*B(J)
-      //   13    CONTINUE
-      for (int j = i + 1; j <= NP; j++)
+  for (int i = 1; i <= N; i++) {
+    H[i][1] = A[i][1] - A[i][6];
+    H[i][2] = A[i][2];
+    H[i][3] = A[i][3];
+    H[i][4] = A[i][4] - A[i][6];
+    H[i][5] = A[i][5];
+  }
+  Zero(&Z1[0][0], 100);
+  Zero(&Z2[0][0], 100);
+  for (int i = 1; i <= 5; i++)
+    for (int j = 1; j <= 5; j++) {
+      ATA[i][j] = 0.0;
+      for (int k = 1; k <= N; k++)
+        ATA[i][j] = ATA[i][j] + H[k][j] * H[k][i];
+      Z1[i][j] = ATA[i][j];
+    }
+  INVMAT(Z1, Z2, 5);
+  for (int i = 1; i <= 5; i++)
+    for (int j = 1; j <= 5; j++)
+      NINV[i][j][2] = Z2[i][j];
+  for (int i = 1; i <= 5; i++)
+    for (int j = 1; j <= N; j++) {
+      PINV[i][j][2] = 0.0;
+      for (int k = 1; k <= 5; k++)
+        PINV[i][j][2] = PINV[i][j][2] + Z2[i][k] * H[j][k] * 1.0e+12;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::IRLS(Taquart::NormType ANormType) {
+  // Full (RM(I,1)) and trace-null (RM(I,2)) solutions in the Lp or Huber norm
+  // by iteratively reweighted least squares. Every iteration solves the
+  // normal equations of MOM2 weighted by W(I) computed from the residuals of
+  // the previous one, starting from the L2 solution. The rest of the
+  // inversion is left to MOM2 with PRESOLVED set.
+  const int MAXITER = 50;
+  const double TOL = 1.0e-6;
+  Taquart::ChannelMatrix<double, 6 + 1> C(N);
+  std::vector<double> W(N + 1), R(N + 1), T(N + 1);
+  double Z1[9 + 1][9 + 1], Z2[9 + 1][9 + 1];
+  double B[6 + 1], X[6 + 1], XOLD[6 + 1];
+  Zero(X, 7);
+
+  if (!GEOREADY) AMATRX();
+
+  // Residuals below DELTA do not increase the Lp weights any further.
+  double DELTA = 0.0;
+  for (int i = 1; i <= N; i++)
+    if (fabs(U[i]) > DELTA) DELTA = fabs(U[i]);
+  DELTA = DELTA * 1.0e-6;
+  const double P = LpExponent < 1.0 ? 1.0 : (LpExponent > 2.0 ?
+      2.0 : LpExponent);
+
+  for (int L = 1; L <= 2; L++) {
+    // Columns of the full (L=1) or the trace-null (L=2) problem.
+    const int NP = (L == 1) ? 6 : 5;
+    for (int i = 1; i <= N; i++) {
+      if (L == 1) {
+        for (int j = 1; j <= 6; j++)
+          C[i][j] = A[i][j];
+      }
+      else {
+        C[i][1] = A[i][1] - A[i][6];
+        C[i][2] = A[i][2];
+        C[i][3] = A[i][3];
+        C[i][4] = A[i][4] - A[i][6];
+        C[i][5] = A[i][5];
+      }
+      W[i] = 1.0;
+    }
+
+    double HUBER = 0.0;
+    for (int ITER = 1; ITER <= MAXITER; ITER++) {
+      Zero(&Z1[0][0], 100);
+      Zero(&Z2[0][0], 100);
+      for (int i = 1; i <= NP; i++) {
+        for (int j = 1; j <= NP; j++) {
+          Z1[i][j] = 0.0;
+          for (int k = 1; k <= N; k++)
+            Z1[i][j] = Z1[i][j] + W[k] * C[k][j] * C[k][i];
+        }
+        B[i] = 0.0;
+        for (int k = 1; k <= N; k++)
+          B[i] = B[i] + W[k] * C[k][i] * U[k] * 1.0e+12;
+      }
+      INVMAT(Z1, Z2, NP);
+      for (int i = 1; i <= NP; i++) {
+        XOLD[i] = X[i];
+        X[i] = 0.0;
+        for (int j = 1; j <= NP; j++)
+          X[i] = X[i] + Z2[i][j] * B[j];
+      }
+
+      double DX = 0.0, XMAX = 0.0;
+      for (int i = 1; i <= NP; i++) {
+        if (fabs(X[i] - XOLD[i]) > DX) DX = fabs(X[i] - XOLD[i]);
+        if (fabs(X[i]) > XMAX) XMAX = fabs(X[i]);
+      }
+      if (ITER > 1 && DX <= TOL * XMAX) break;
+
+      for (int i = 1; i <= N; i++) {
+        R[i] = U[i];
+        for (int j = 1; j <= NP; j++)
+          R[i] = R[i] - C[i][j] * X[j] * 1.0e-12;
+      }
+
+      // The Huber threshold is fixed by the median absolute deviation of the
+      // L2 residuals.
+      if (ANormType == Taquart::ntHuber && ITER == 1) {
+        for (int i = 1; i <= N; i++) {
+          double HELP = fabs(R[i]);
+          int k = i;
+          for (; k > 1 && T[k - 1] > HELP; k--)
+            T[k] = T[k - 1];
+          T[k] = HELP;
+        }
+        HUBER = HuberConstant * 0.5 * (T[(N + 1) / 2] + T[N / 2 + 1])
+            / 0.6745;
+      }
+
+      for (int i = 1; i <= N; i++) {
+        const double HELP = fabs(R[i]);
+        if (ANormType == Taquart::ntHuber)
+          W[i] = (HELP <= HUBER || HUBER == 0.0) ? 1.0 : HUBER / HELP;
+        else
+          W[i] = pow(HELP > DELTA ? HELP : DELTA, P - 2.0);
+      }
+    }
+
+    for (int i = 1; i <= NP; i++)
+      RM[i][L] = X[i];
+  }
+
+  //      RM(6,2)=-RM(1,2)-RM(4,2)
+  RM[6][2] = -RM[1][2] - RM[4][2];
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::PrepareL2Batch(
+    const Taquart::SMTInputView &InputData) {
+  RDINP(InputData);
+  GEOMET();
+  PSINV();
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::SolveL2Batch(const double UBatch[], double RMBatch[],
+    int Count) {
+  // Sample k reads N amplitudes from UBatch[k*N] and writes L2BATCH_STRIDE
+  // values to RMBatch[k*L2BATCH_STRIDE]: RM(1..6,1) followed by RM(1..6,2).
+  // The product RM = P*U of the packed pseudo-inverses P (L2BATCH_STRIDE x N,
+  // row 12 zero) and the amplitudes U (N x Count) is computed for blocks of
+  // BLOCK samples, with the station loop outside, so every row of P is read
+  // once per block and the sums over the stations keep their order.
+  const int BLOCK = 64;
+  std::vector<double> P(L2BATCH_STRIDE * (N + 1), 0.0);
+  for (int j = 1; j <= N; j++) {
+    for (int i = 1; i <= 6; i++)
+      P[L2BATCH_STRIDE * j + i - 1] = PINV[i][j][1];
+    for (int i = 1; i <= 5; i++)
+      P[L2BATCH_STRIDE * j + 6 + i - 1] = PINV[i][j][2];
+  }
+
+  double SUM[BLOCK][L2BATCH_STRIDE];
+  for (int k0 = 0; k0 < Count; k0 += BLOCK) {
+    const int NK = (k0 + BLOCK < Count) ? BLOCK : Count - k0;
+    Zero(&SUM[0][0], BLOCK * L2BATCH_STRIDE);
+    for (int j = 1; j <= N; j++) {
+      const double * p = &P[L2BATCH_STRIDE * j];
+      for (int k = 0; k < NK; k++) {
+        const double u = UBatch[(k0 + k) * N + j - 1];
+        double * sum = SUM[k];
+        for (int i = 0; i < L2BATCH_STRIDE; i++)
+          sum[i] = sum[i] + p[i] * u;
+      }
+    }
+    for (int k = 0; k < NK; k++) {
+      double * rm = &RMBatch[(k0 + k) * L2BATCH_STRIDE];
+      for (int i = 0; i < 11; i++)
+        rm[i] = SUM[k][i];
+      rm[11] = -rm[6] - rm[9];
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::RunL2Batch(int QualityType, const double USample[],
+    const double RMSample[], int * const AThreadProgress) {
+  ThreadProgress = AThreadProgress;
+  PROGRESS(0, 350);
+  for (int i = 1; i <= N; i++)
+    U[i] = USample[i - 1];
+  for (int i = 1; i <= 6; i++) {
+    RM[i][1] = RMSample[i - 1];
+    RM[i][2] = RMSample[6 + i - 1];
+  }
+  MOM2(true, QualityType, true);
+  PROGRESS(360, 350);
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::RunL2Jackknife(const Taquart::UsmtCore &Full,
+    int Channel, int QualityType, int * const AThreadProgress) {
+  ThreadProgress = AThreadProgress;
+  PROGRESS(0, 350);
+
+  // Copy the input data of all channels but the removed one.
+  CHANNELS(Full.N);
+  N = 0;
+  for (int i = 1; i <= Full.N; i++) {
+    if (i == Channel) continue;
+    N = N + 1;
+    U[N] = Full.U[i];
+    AZM[N] = Full.AZM[i];
+    TKF[N] = Full.TKF[i];
+    RO[N] = Full.RO[i];
+    VEL[N] = Full.VEL[i];
+    R[N] = Full.R[i];
+    for (int j = 1; j <= 3; j++)
+      GA[N][j] = Full.GA[i][j];
+    for (int j = 1; j <= 6; j++)
+      A[N][j] = Full.A[i][j];
+    for (int j = 1; j <= 3; j++)
+      for (int k = 1; k <= 3; k++)
+        FIJ[j][k][N] = Full.FIJ[j][k][i];
+  }
+  TROZ = Full.TROZ;
+  GEOREADY = Full.GEOREADY;
+  JEZOK = JEZ();
+
+  // Removing the channel changes the normal matrix by the rank-one term
+  // a*aT, where a is the row of the design matrix of that channel. Its
+  // inverse follows from the Sherman-Morrison formula:
+  // (ATA-a*aT)**(-1) = G + G*a*aT*G/(1-aT*G*a), G = (ATA)**(-1).
+  double a[6 + 1], Ga[6 + 1], aG[6 + 1], B[6 + 1], HR[6 + 1];
+  for (int s = 1; s <= 2; s++) {
+    const int NP = (s == 1) ? 6 : 5;
+    for (int j = 1; j <= 6; j++)
+      a[j] = Full.A[Channel][j];
+    if (s == 2) {
+      a[1] = a[1] - a[6];
+      a[4] = a[4] - a[6];
+    }
+
+    double DEN = 1.0;
+    for (int i = 1; i <= NP; i++) {
+      Ga[i] = 0.0;
+      aG[i] = 0.0;
+      for (int j = 1; j <= NP; j++) {
+        Ga[i] = Ga[i] + Full.NINV[i][j][s] * a[j];
+        aG[i] = aG[i] + a[j] * Full.NINV[j][i][s];
+      }
+    }
+    for (int i = 1; i <= NP; i++)
+      DEN = DEN - a[i] * Ga[i];
+
+    // The remaining stations do not constrain the solution well enough for
+    // the downdate, solve the reduced problem from scratch.
+    if (DEN < 1.0e-8) {
+      MOM2(true, QualityType);
+      PROGRESS(360, 350);
+      return;
+    }
+
+    // Right-hand side from the remaining channels.
+    for (int i = 1; i <= NP; i++)
+      B[i] = 0.0;
+    for (int k = 1; k <= N; k++) {
+      for (int j = 1; j <= 6; j++)
+        HR[j] = A[k][j];
+      if (s == 2) {
+        HR[1] = HR[1] - HR[6];
+        HR[4] = HR[4] - HR[6];
+      }
+      for (int i = 1; i <= NP; i++)
+        B[i] = B[i] + HR[i] * U[k] * 1.0e+12;
+    }
+
+    for (int i = 1; i <= NP; i++) {
+      RM[i][s] = 0.0;
+      for (int j = 1; j <= NP; j++)
+        RM[i][s] = RM[i][s]
+            + (Full.NINV[i][j][s] + Ga[i] * aG[j] / DEN) * B[j];
+    }
+  }
+
+  MOM2(true, QualityType, true);
+  PROGRESS(360, 350);
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::BenchmarkEigen(int Count, double Time[],
+    double &MaxError, double &MaxTrace) {
+  // Tensors with M0=1e11: general ones, uniaxial ones (a double eigenvalue),
+  // double-couples and uniaxial ones perturbed by 1e-9, in turn.
+  const bool SAVE = ClosedFormEigen;
+  double * Q = new double[6 * Count + 1];
+  double * E = new double[6 * Count + 1];
+  uint64_t STATE = 0x9E3779B97F4A7C15ULL;
+  double V[3 + 1], W[3 + 1];
+  for (int k = 0; k < Count; k++) {
+    double * q = &Q[6 * k];
+    double R[6 + 1];
+    for (int i = 1; i <= 6; i++) {
+      STATE ^= STATE << 13;
+      STATE ^= STATE >> 7;
+      STATE ^= STATE << 17;
+      R[i] = double(STATE >> 11) / 9007199254740992.0 * 2.0 - 1.0;
+    }
+    double HELP = sqrt(R[1] * R[1] + R[2] * R[2] + R[3] * R[3]);
+    for (int i = 1; i <= 3; i++)
+      V[i] = R[i] / HELP;
+    switch (k % 4) {
+      case 0:
+        for (int i = 1; i <= 6; i++)
+          q[i] = R[i];
+        break;
+      case 1:
+      case 3:
+        // a*I+b*V*VT
+        q[1] = R[4] + R[5] * V[1] * V[1];
+        q[2] = R[5] * V[1] * V[2];
+        q[3] = R[5] * V[1] * V[3];
+        q[4] = R[4] + R[5] * V[2] * V[2];
+        q[5] = R[5] * V[2] * V[3];
+        q[6] = R[4] + R[5] * V[3] * V[3];
+        if (k % 4 == 3) for (int i = 1; i <= 6; i++)
+          q[i] = q[i] * (1.0 + 1.0e-9 * R[7 - i]);
+        break;
+      case 2:
+        // V*WT+W*VT with W orthogonal to V
+        W[1] = R[5] * V[3] - R[6] * V[2];
+        W[2] = R[6] * V[1] - R[4] * V[3];
+        W[3] = R[4] * V[2] - R[5] * V[1];
+        HELP = sqrt(W[1] * W[1] + W[2] * W[2] + W[3] * W[3]);
+        for (int i = 1; i <= 3; i++)
+          W[i] = W[i] / HELP;
+        q[1] = 2.0 * V[1] * W[1];
+        q[2] = V[1] * W[2] + V[2] * W[1];
+        q[3] = V[1] * W[3] + V[3] * W[1];
+        q[4] = 2.0 * V[2] * W[2];
+        q[5] = V[2] * W[3] + V[3] * W[2];
+        q[6] = 2.0 * V[3] * W[3];
+        break;
+    }
+    for (int i = 1; i <= 6; i++)
+      q[i] = q[i] * 1.0e+11;
+  }
+
+  for (int m = 0; m <= 1; m++) {
+    ClosedFormEigen = (m == 1);
+    const double TIME0 = WallTime();
+    for (int k = 0; k < Count; k++)
+      EIG3(&Q[6 * k], 0, &E[3 * (2 * k + m)]);
+    Time[m + 1] = (WallTime() - TIME0) / double(Count > 0 ? Count : 1);
+  }
+  ClosedFormEigen = SAVE;
+
+  MaxError = 0.0;
+  MaxTrace = 0.0;
+  for (int k = 0; k < Count; k++) {
+    double S[2][3];
+    for (int m = 0; m <= 1; m++) {
+      for (int i = 0; i < 3; i++)
+        S[m][i] = E[3 * (2 * k + m) + i + 1];
+      for (int i = 1; i < 3; i++)
+        for (int j = i; j > 0 && S[m][j - 1] > S[m][j]; j--) {
+          const double HELP = S[m][j];
+          S[m][j] = S[m][j - 1];
+          S[m][j - 1] = HELP;
+        }
+    }
+    double EMAX = 0.0;
+    for (int i = 0; i < 3; i++)
+      if (fabs(S[0][i]) > EMAX) EMAX = fabs(S[0][i]);
+    if (EMAX == 0.0) continue;
+    for (int i = 0; i < 3; i++)
+      if (fabs(S[1][i] - S[0][i]) / EMAX > MaxError)
+        MaxError = fabs(S[1][i] - S[0][i]) / EMAX;
+    const double * q = &Q[6 * k];
+    const double TRACE = fabs(S[1][0] + S[1][1] + S[1][2] - q[1] - q[4] - q[6])
+        / EMAX;
+    if (TRACE > MaxTrace) MaxTrace = TRACE;
+  }
+  delete[] Q;
+  delete[] E;
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::INVMAT(double A[][10], double B[][10], int NP) {
+  //      SUBROUTINE INVMAT(A,B,NP)
+  //C     Routine inverts matrix A of dimensions 9*9
+  //      DIMENSION A(9,9),B(9,9),Y(9,9),ALU(9,9),INDX(9)
+  //      EXTERNAL LUDCMP,LUBKSB
+
+  double Y[10][10];
+  Zero(&Y[0][0], 100);
+  double ALU[10][10];
+  Zero(&ALU[0][0], 100);
+  int INDX[10];
+  for (int i = 0; i < 10; i++)
+    INDX[i] = 0;
+  double D = 0;
+
+  //      DO 12 I=1,NP
+  //       DO 11 J=1,NP
+  //        Y(I,J)=0.
+  //   11   CONTINUE
+  //       Y(I,I)=1.
+  //   12 CONTINUE
+  for (int i = 1; i <= NP; i++) {
+    for (int j = 1; j <= NP; j++) {
+      Y[i][j] = 0.0;
+    }
+    Y[i][i] = 1.0;
+  }
+
+  //      CALL LUDCMP(A,ALU,INDX,D,NP)
+  LUDCMP(A, ALU, INDX, D, NP);
+
+  //      DO 13 J=1,NP
+  //       CALL LUBKSB(ALU,INDX,Y(1,J),B(1,J),NP)
+  //   13  CONTINUE
+  for (int j = 1; j <= NP; j++) {
+    LUBKSB2(ALU, INDX, Y, B, NP, j);
+  }
+
+  //      RETURN
+  //      END
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::LUBKSB2(double A[][10], int INDX[], double C[][10],
+    double B[][10], int &NP, int jj) {
+  //      SUBROUTINE LUBKSB(A,INDX,C,B,NP)
+  //C     Routine solves set of linear equations AX=B. Matrix A is input as its
+  //C     LU decomposition. INDX is permutation vector. C is input as right-hand
+  //C     side vector and solution is returned as B. A, and INDX are not modified.
+  //      DIMENSION A(9,9),INDX(9),B(9),C(9)
+
+  //      DO 1 I=1,NP
+  //    1  B(I)=C(I)
+  for (int i = 1; i <= NP; i++)
+    B[i][jj] = C[i][jj];
+
+  //      II=0
+  int II = 0;
+
+  //      DO 12 I=1,NP
+  for (int i = 1; i <= NP; i++) {
+    //       LL=INDX(I)
+    //       SUM=B(LL)
+    //       B(LL)=B(I)
+    int LL = INDX[i];
+    double SUM = B[LL][jj];
+    B[LL][jj] = B[i][jj];
+
+    //       IF(II.NE.0) THEN
+    if (II != 0) {
+      //        DO 11 J=II,I-1
+      //         SUM=SUM-A(I,J)*B(J)
+      //   11    CONTINUE
+      for (int j = II; j <= i - 1; j++)
+        SUM = SUM - A[i][j] * B[j][jj];
+    }
+    //        ELSE IF(SUM.NE.0.) THEN
+    else if (SUM != 0.0) {
+      //         II=I
+      II = i;
+    }
+    //        ENDIF
+    //       B(I)=SUM
+    B[i][jj] = SUM;
+  }
+  //   12  CONTINUE
+
+  //      DO 14 I=NP,1,-1
+  for (int i = NP; i >= 1; i--) {
+    //       SUM=B(I)
+    double SUM = B[i][jj];
+    //       IF(I.LT.NP) THEN
+    if (i < NP) {
+      //        DO 13 J=I+1,NP
+      //         SUM=SUM-A(I,J)*B(J)
+      //   13    CONTINUE
+      for (int j = i + 1; j <= NP; j++)
         SUM = SUM - A[i][j] * B[j][jj];
     }
     //        ENDIF
@@ -2752,15 +3660,13 @@ void Taquart::UsmtCore::BETTER(double &RMY, double &RMZ, double &RM0,
   Zero(VN, 4);
   double VE[3 + 1];
   Zero(VE, 4);
-  double AM0[MAXCHANNEL + 1];
-  Zero(AM0, MAXCHANNEL + 1);
+  std::vector<double> AM0(N + 1);
   double DD[6 + 1];
   Zero(DD, 7);
   double EQM[3 + 1];
   Zero(EQM, 4);
   double EC = 0.0;
-  double C[6 + 1][MAXCHANNEL + 1];
-  Zero(&C[0][0], 7 * (MAXCHANNEL + 1));
+  Taquart::ChannelRows<double, 6 + 1> C(N);
   double BB[8 + 1][8 + 1];
   Zero(&BB[0][0], 81);
   double BBINV[8 + 1][8 + 1];
@@ -2771,8 +3677,7 @@ void Taquart::UsmtCore::BETTER(double &RMY, double &RMZ, double &RM0,
   Zero(&Z2[0][0], 100);
   double DE[3 + 1];
   Zero(DE, 4);
-  double DU[MAXCHANNEL + 1];
-  Zero(DU, MAXCHANNEL + 1);
+  std::vector<double> DU(N + 1);
   double DN[3 + 1];
   Zero(DN, 4);
   double CTDU[8 + 1];
@@ -2849,6 +3754,13 @@ void Taquart::UsmtCore::BETTER(double &RMY, double &RMZ, double &RM0,
     VN[i] = VN[i] / SN;
   }
 
+  // VN and VE are the axes of the largest and of the intermediate
+  // eigenvalue, i.e. the starting T and P axes (or P and T) of DCLM.
+  if (LMDoubleCouple && DCLM(VN, VE, RM0, ICOND)) {
+    RMT = RM0;
+    return;
+  }
+
   //      DO 3203 L=1,N
   //      U0=dble(0.)
   //      U1=dble(0.)
@@ -3130,10 +4042,12 @@ void Taquart::UsmtCore::BETTER(double &RMY, double &RMZ, double &RM0,
   // 3418 ICOND=2
   //      GO TO 3419
   p3418: ICOND = 2;
+  DCITER = ITER;
   goto p3419;
 
   // 3417 ICOND=3
   p3417: ICOND = 3;
+  DCITER = ITER;
   // 3419 IF(ISTA.EQ.0) GO TO 8887
   p3419: if (ISTA == 0) goto p8887;
   //      WRITE(75,400)
@@ -3149,6 +4063,7 @@ void Taquart::UsmtCore::BETTER(double &RMY, double &RMZ, double &RM0,
 
   // 3017 CALL ORT(VE,VN,DE,DN)
   p3017: ORT(VE, VN, DE, DN);
+  DCITER = ITER;
 
   //c     These ve and vn correspond to force coordinates XY;
   //c     they need to be converted to displacement axes PT.
@@ -3252,28 +4167,351 @@ void Taquart::UsmtCore::BETTER(double &RMY, double &RMZ, double &RM0,
 }
 
 //-----------------------------------------------------------------------------
-void Taquart::UsmtCore::VEIG(double &s1, double &s2, double &s3, double &s4,
-    double &s5, double &s6, double v[]) {
-  //      SUBROUTINE VEIG(S1,S2,S3,S4,S5,S6,V)
-  //      dimension v(3)
-  //      double precision help0(6),help1,help2
-  double help0[6 + 1];
-  double help1 = 0.0;
-  double help2 = 0.0;
+bool Taquart::UsmtCore::DCLM(const double VT[], const double VP[], double &RM0,
+    int &ICOND) {
+  // Levenberg-Marquardt fit of the double couple S*(T*TT-P*PT), T and P
+  // orthonormal, to the amplitudes U through the design matrix A, which
+  // also gives the double-couple errors in MOM2. T and P start from VT and
+  // VP and are turned by a rotation vector W(1..3); the Jacobian of the
+  // amplitudes with respect to W and S is analytic. RM(I,3) receives the
+  // fit and RM0=ABS(S). ICOND is 1 on convergence and 2 when MAXIT
+  // iterations were not enough. Returns false, with nothing changed, when
+  // the starting double couple predicts no amplitudes.
+  const int MAXIT = 100;
+  const int II[6 + 1] = { 0, 1, 1, 1, 2, 2, 3 };
+  const int JJ[6 + 1] = { 0, 1, 2, 3, 2, 3, 3 };
+  double T[3 + 1], P[3 + 1], TT[3 + 1], PT[3 + 1];
+  double D[6 + 1], DD[6 + 1][3 + 1];
+  std::vector<double> G(N + 1);
+  double Z1[9 + 1][9 + 1], Z2[9 + 1][9 + 1], AN[4 + 1][4 + 1], B[4 + 1],
+      X[4 + 1];
+
+  // Starting axes (P orthogonalised against T) and the scale S0 of S, so
+  // that all four unknowns are of order one.
+  double HELP = 0.0;
+  for (int i = 1; i <= 3; i++) {
+    T[i] = VT[i];
+    HELP = HELP + VT[i] * VP[i];
+  }
+  for (int i = 1; i <= 3; i++)
+    P[i] = VP[i] - HELP * T[i];
+  HELP = sqrt(P[1] * P[1] + P[2] * P[2] + P[3] * P[3]);
+  if (HELP == 0.0) return false;
+  for (int i = 1; i <= 3; i++)
+    P[i] = P[i] / HELP;
 
-  //      v(1)=1.
-  //      v(2)=0.
-  //      v(3)=0.
-  v[1] = 1.0;
-  v[2] = 0.0;
-  v[3] = 0.0;
+  for (int m = 1; m <= 6; m++)
+    D[m] = T[II[m]] * T[JJ[m]] - P[II[m]] * P[JJ[m]];
+  double SUG = 0.0, SGG = 0.0;
+  for (int l = 1; l <= N; l++) {
+    G[l] = 0.0;
+    for (int m = 1; m <= 6; m++)
+      G[l] = G[l] + A[l][m] * D[m] * 1.0e-12;
+    SUG = SUG + U[l] * G[l];
+    SGG = SGG + G[l] * G[l];
+  }
+  if (SGG == 0.0 || SUG == 0.0) return false;
+  const double S0 = SUG / SGG;
+  double SIG = 1.0;
+  double F = 0.0;
+  for (int l = 1; l <= N; l++)
+    F = F + (U[l] - S0 * G[l]) * (U[l] - S0 * G[l]);
+
+  double LAMBDA = 1.0e-3;
+  bool CONV = false;
+  int ITER = 0;
+  while (!CONV && ITER < MAXIT) {
+    ITER++;
+    // Derivatives of D with respect to W: dT/dW(k)=E(k)xT, dP/dW(k)=E(k)xP.
+    for (int k = 1; k <= 3; k++) {
+      const int k1 = k % 3 + 1, k2 = (k + 1) % 3 + 1;
+      double CT[3 + 1], CP[3 + 1];
+      CT[k] = 0.0;
+      CT[k1] = -T[k2];
+      CT[k2] = T[k1];
+      CP[k] = 0.0;
+      CP[k1] = -P[k2];
+      CP[k2] = P[k1];
+      for (int m = 1; m <= 6; m++)
+        DD[m][k] = CT[II[m]] * T[JJ[m]] + T[II[m]] * CT[JJ[m]]
+            - CP[II[m]] * P[JJ[m]] - P[II[m]] * CP[JJ[m]];
+    }
 
-  //      help0(1)=s4*s6-s5*s5
-  //      help0(2)=s1*s6-s3*s3
-  //      help0(3)=s1*s4-s2*s2
-  //      help0(4)=s2*s5-s4*s3
-  //      help0(5)=s2*s6-s3*s5
-  //      help0(6)=s1*s5-s2*s3
+    // Normal equations of the residuals U-S0*SIG*G.
+    Zero(&AN[0][0], 25);
+    Zero(B, 5);
+    for (int l = 1; l <= N; l++) {
+      double J[4 + 1];
+      for (int k = 1; k <= 3; k++) {
+        J[k] = 0.0;
+        for (int m = 1; m <= 6; m++)
+          J[k] = J[k] + A[l][m] * DD[m][k];
+        J[k] = J[k] * S0 * SIG * 1.0e-12;
+      }
+      J[4] = S0 * G[l];
+      const double RES = U[l] - S0 * SIG * G[l];
+      for (int i = 1; i <= 4; i++) {
+        B[i] = B[i] + J[i] * RES;
+        for (int j = 1; j <= 4; j++)
+          AN[i][j] = AN[i][j] + J[i] * J[j];
+      }
+    }
+
+    // Damped steps until the misfit decreases.
+    bool ACCEPT = false;
+    while (!ACCEPT && LAMBDA < 1.0e+10) {
+      Zero(&Z1[0][0], 100);
+      Zero(&Z2[0][0], 100);
+      for (int i = 1; i <= 4; i++)
+        for (int j = 1; j <= 4; j++)
+          Z1[i][j] = AN[i][j] + ((i == j) ? LAMBDA * AN[i][i] : 0.0);
+      INVMAT(Z1, Z2, 4);
+      for (int i = 1; i <= 4; i++) {
+        X[i] = 0.0;
+        for (int j = 1; j <= 4; j++)
+          X[i] = X[i] + Z2[i][j] * B[j];
+      }
+
+      // Rodrigues rotation of T and P by X(1..3).
+      const double TH = sqrt(X[1] * X[1] + X[2] * X[2] + X[3] * X[3]);
+      for (int i = 1; i <= 3; i++) {
+        TT[i] = T[i];
+        PT[i] = P[i];
+      }
+      if (TH > 0.0) {
+        const double K[3 + 1] = { 0.0, X[1] / TH, X[2] / TH, X[3] / TH };
+        const double CS = cos(TH), SN = sin(TH);
+        for (int n = 0; n <= 1; n++) {
+          const double * V = n ? P : T;
+          double * W = n ? PT : TT;
+          const double KV = K[1] * V[1] + K[2] * V[2] + K[3] * V[3];
+          W[1] = V[1] * CS + (K[2] * V[3] - K[3] * V[2]) * SN
+              + K[1] * KV * (1.0 - CS);
+          W[2] = V[2] * CS + (K[3] * V[1] - K[1] * V[3]) * SN
+              + K[2] * KV * (1.0 - CS);
+          W[3] = V[3] * CS + (K[1] * V[2] - K[2] * V[1]) * SN
+              + K[3] * KV * (1.0 - CS);
+        }
+      }
+      for (int m = 1; m <= 6; m++)
+        D[m] = TT[II[m]] * TT[JJ[m]] - PT[II[m]] * PT[JJ[m]];
+      const double SIGT = SIG + X[4];
+      double FT = 0.0;
+      for (int l = 1; l <= N; l++) {
+        HELP = 0.0;
+        for (int m = 1; m <= 6; m++)
+          HELP = HELP + A[l][m] * D[m] * 1.0e-12;
+        FT = FT + (U[l] - S0 * SIGT * HELP) * (U[l] - S0 * SIGT * HELP);
+      }
+
+      if (FT <= F) {
+        ACCEPT = true;
+        CONV = (F - FT <= 1.0e-12 * F) || (TH <= 1.0e-10
+            && fabs(X[4]) <= 1.0e-10 * fabs(SIGT));
+        F = FT;
+        SIG = SIGT;
+        for (int i = 1; i <= 3; i++) {
+          T[i] = TT[i];
+          P[i] = PT[i];
+        }
+        for (int l = 1; l <= N; l++) {
+          G[l] = 0.0;
+          for (int m = 1; m <= 6; m++)
+            G[l] = G[l] + A[l][m] * D[m] * 1.0e-12;
+        }
+        LAMBDA = amax1(LAMBDA * 0.1, 1.0e-12);
+      }
+      else
+        LAMBDA = LAMBDA * 10.0;
+    }
+    // No damping lowers the misfit any more: T and P are at the minimum.
+    if (!ACCEPT) CONV = true;
+  }
+
+  for (int m = 1; m <= 6; m++)
+    RM[m][3] = S0 * SIG * (T[II[m]] * T[JJ[m]] - P[II[m]] * P[JJ[m]]);
+  RM0 = fabs(S0 * SIG);
+  ICOND = CONV ? 1 : 2;
+  DCITER = ITER;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::GRIDDC(int LNORM, double SCALE, double &RM0) {
+  // Double couple from the strike/dip/rake grid (see DCGridStep). The unit
+  // tensor of a node is COS(RAKE)*MC+SIN(RAKE)*MS with MC and MS depending
+  // on the strike and dip only, so their amplitudes are tabulated once per
+  // (strike, dip) node and station (TAB), and all rakes of the node are
+  // swept while its 2*N entries are in cache. The scalar moment M>=0 of a
+  // node is fitted in the L2 (LNORM=2) or the L1 (LNORM=1) norm; the L2 fit
+  // needs five sums over the stations per node only. SCALE converts A*M to
+  // the units of U (1.E-12 in MOM2, 1 in MOM1). RM(I,3) receives the
+  // optimum and RM0 its scalar moment.
+  const double DEG = 4.0 * atan(1.0) / 180.0;
+  const double STEP =
+      (DCGridStep < DCGRID_MIN_STEP) ? DCGRID_MIN_STEP : DCGridStep;
+  const int NS = (360.0 / STEP < 1.5) ? 1 : int(360.0 / STEP + 0.5);
+  const int ND = (90.0 / STEP < 1.5) ? 2 : int(90.0 / STEP + 0.5) + 1;
+  const int NR = NS;
+  const double SS = 360.0 / NS, SD = 90.0 / (ND - 1), SR = 360.0 / NR;
+  DCGridSize[1] = NS;
+  DCGridSize[2] = ND;
+  DCGridSize[3] = NR;
+  DCSurface.resize(size_t(NS) * ND * NR);
+
+  std::vector<double> TAB(size_t(NS) * ND * 2 * N);
+  std::vector<double> COSR(NR), SINR(NR);
+  for (int ir = 0; ir < NR; ir++) {
+    COSR[ir] = cos((-180.0 + ir * SR) * DEG);
+    SINR[ir] = sin((-180.0 + ir * SR) * DEG);
+  }
+  double SUU = 0.0;
+  for (int i = 1; i <= N; i++)
+    SUU = SUU + ((LNORM == 2) ? U[i] * U[i] : fabs(U[i]));
+  if (SUU == 0.0) SUU = 1.0;
+
+#pragma omp parallel for num_threads(GridThreads) schedule(dynamic, 1) if (GridThreads > 1)
+  for (int is = 0; is < NS; is++) {
+    std::vector<double> G(N + 1);
+    std::vector<std::pair<double, int> > R(N);
+    for (int id = 0; id < ND; id++) {
+      double * T = &TAB[(size_t(is) * ND + id) * 2 * N];
+      double MC[6 + 1], MS[6 + 1];
+      Taquart::StrikeDipRake2MT(is * SS * DEG, id * SD * DEG, 0.0, MC[1],
+          MC[4], MC[6], MC[2], MC[3], MC[5]);
+      Taquart::StrikeDipRake2MT(is * SS * DEG, id * SD * DEG, 90.0 * DEG,
+          MS[1], MS[4], MS[6], MS[2], MS[3], MS[5]);
+      for (int i = 1; i <= N; i++) {
+        double G1 = 0.0, G2 = 0.0;
+        for (int j = 1; j <= 6; j++) {
+          G1 = G1 + A[i][j] * MC[j];
+          G2 = G2 + A[i][j] * MS[j];
+        }
+        T[2 * i - 2] = G1 * SCALE;
+        T[2 * i - 1] = G2 * SCALE;
+      }
+
+      double * F = &DCSurface[(size_t(is) * ND + id) * NR];
+      if (LNORM == 2) {
+        double UA = 0.0, UB = 0.0, AA = 0.0, AB = 0.0, BB = 0.0;
+        for (int i = 1; i <= N; i++) {
+          const double G1 = T[2 * i - 2], G2 = T[2 * i - 1];
+          UA = UA + U[i] * G1;
+          UB = UB + U[i] * G2;
+          AA = AA + G1 * G1;
+          AB = AB + G1 * G2;
+          BB = BB + G2 * G2;
+        }
+        for (int ir = 0; ir < NR; ir++) {
+          const double C = COSR[ir], S = SINR[ir];
+          const double UG = C * UA + S * UB;
+          const double GG = C * C * AA + 2.0 * C * S * AB + S * S * BB;
+          double HELP = SUU;
+          if (UG > 0.0 && GG > 0.0) HELP = SUU - UG * UG / GG;
+          F[ir] = sqrt((HELP > 0.0 ? HELP : 0.0) / SUU);
+        }
+      }
+      else
+        for (int ir = 0; ir < NR; ir++) {
+          for (int i = 1; i <= N; i++)
+            G[i] = COSR[ir] * T[2 * i - 2] + SINR[ir] * T[2 * i - 1];
+          double HELP = 0.0;
+          DCL1Moment(U, &G[0], N, R, HELP);
+          F[ir] = HELP / SUU;
+        }
+    }
+  }
+
+  // The first node of the smallest misfit, whatever the number of threads.
+  size_t KBEST = 0;
+  for (size_t k = 1; k < DCSurface.size(); k++)
+    if (DCSurface[k] < DCSurface[KBEST]) KBEST = k;
+  const int IS = int(KBEST / (size_t(ND) * NR));
+  const int ID = int(KBEST / NR % ND);
+  const int IR = int(KBEST % NR);
+  DCBest[1] = IS * SS;
+  DCBest[2] = ID * SD;
+  DCBest[3] = -180.0 + IR * SR;
+  DCBest[4] = DCSurface[KBEST];
+
+  double MB[6 + 1];
+  std::vector<double> G(N + 1);
+  Taquart::StrikeDipRake2MT(DCBest[1] * DEG, DCBest[2] * DEG, DCBest[3] * DEG,
+      MB[1], MB[4], MB[6], MB[2], MB[3], MB[5]);
+  const double * T = &TAB[(size_t(IS) * ND + ID) * 2 * N];
+  double UG = 0.0, GG = 0.0;
+  for (int i = 1; i <= N; i++) {
+    G[i] = COSR[IR] * T[2 * i - 2] + SINR[IR] * T[2 * i - 1];
+    UG = UG + U[i] * G[i];
+    GG = GG + G[i] * G[i];
+  }
+  if (LNORM == 2)
+    RM0 = (UG > 0.0 && GG > 0.0) ? UG / GG : 0.0;
+  else {
+    std::vector<std::pair<double, int> > R;
+    double HELP = 0.0;
+    RM0 = DCL1Moment(U, &G[0], N, R, HELP);
+  }
+  for (int m = 1; m <= 6; m++)
+    RM[m][3] = RM0 * MB[m];
+}
+
+//-----------------------------------------------------------------------------
+int Taquart::UsmtCore::DCRegion(double Tolerance, double &Angle) const {
+  const double DEG = 4.0 * atan(1.0) / 180.0;
+  const int NS = DCGridSize[1], ND = DCGridSize[2], NR = DCGridSize[3];
+  Angle = 0.0;
+  if (DCSurface.empty()) return 0;
+  const double SS = 360.0 / NS, SD = 90.0 / (ND - 1), SR = 360.0 / NR;
+  // The tolerance is a fraction of the misfit range of the surface, which
+  // does not vanish with the best misfit on noise-free data.
+  double FMAX = DCBest[4];
+  for (size_t k = 0; k < DCSurface.size(); k++)
+    if (DCSurface[k] > FMAX) FMAX = DCSurface[k];
+  const double LIMIT = DCBest[4] + Tolerance * (FMAX - DCBest[4]);
+  double MB[6 + 1], MK[6 + 1];
+  Taquart::StrikeDipRake2MT(DCBest[1] * DEG, DCBest[2] * DEG, DCBest[3] * DEG,
+      MB[1], MB[4], MB[6], MB[2], MB[3], MB[5]);
+  int COUNT = 0;
+  double CMIN = 1.0;
+  for (size_t k = 0; k < DCSurface.size(); k++) {
+    if (DCSurface[k] > LIMIT) continue;
+    COUNT++;
+    Taquart::StrikeDipRake2MT(int(k / (size_t(ND) * NR)) * SS * DEG,
+        int(k / NR % ND) * SD * DEG, (-180.0 + int(k % NR) * SR) * DEG,
+        MK[1], MK[4], MK[6], MK[2], MK[3], MK[5]);
+    // Both unit double couples have the norm SQRT(2).
+    const double C = 0.5 * (MB[1] * MK[1] + MB[4] * MK[4] + MB[6] * MK[6]
+        + 2.0 * (MB[2] * MK[2] + MB[3] * MK[3] + MB[5] * MK[5]));
+    if (C < CMIN) CMIN = C;
+  }
+  Angle = acos(CMIN < -1.0 ? -1.0 : CMIN) / DEG;
+  return COUNT;
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::VEIG(double &s1, double &s2, double &s3, double &s4,
+    double &s5, double &s6, double v[]) {
+  //      SUBROUTINE VEIG(S1,S2,S3,S4,S5,S6,V)
+  //      dimension v(3)
+  //      double precision help0(6),help1,help2
+  double help0[6 + 1];
+  double help1 = 0.0;
+  double help2 = 0.0;
+
+  //      v(1)=1.
+  //      v(2)=0.
+  //      v(3)=0.
+  v[1] = 1.0;
+  v[2] = 0.0;
+  v[3] = 0.0;
+
+  //      help0(1)=s4*s6-s5*s5
+  //      help0(2)=s1*s6-s3*s3
+  //      help0(3)=s1*s4-s2*s2
+  //      help0(4)=s2*s5-s4*s3
+  //      help0(5)=s2*s6-s3*s5
+  //      help0(6)=s1*s5-s2*s3
   help0[1] = s4 * s6 - s5 * s5;
   help0[2] = s1 * s6 - s3 * s3;
   help0[3] = s1 * s4 - s2 * s2;
@@ -3582,9 +4820,8 @@ bool Taquart::UsmtCore::JEZ(void) {
   //      DIMENSION NDAE(9),DAE(212,3)
   //      DATA FSTCLL,NDAE/.TRUE.,2*36,2*32,2*24,16,8,4/
 
+  // The DAE table is kept in the context and generated on the first call.
   bool USEDAE[213];
-  double DAE[212 + 1][3 + 1];
-  Zero(&DAE[0][0], 213 * 4);
 
   //      IOK=.TRUE.
 
@@ -3624,7 +4861,7 @@ bool Taquart::UsmtCore::JEZ(void) {
 
   //   10 DO 3 I=1,212
   //    3 USEDAE(I)=.TRUE.
-  for (int i = 1; i <= 213; i++)
+  for (int i = 1; i <= 212; i++)
     USEDAE[i] = true;
 
   //      NLIVE=212
@@ -3711,8 +4948,135 @@ void Taquart::UsmtCore::PROGRESS(double Progress, double Max) {
   std::cout << std::endl;
 #endif
 
-  if (ThreadProgress) *ThreadProgress = int(Progress);
+  // USMT_CANCEL stored by the caller is kept.
+  if (ThreadProgress) {
+#ifdef __GNUC__
+    const int OLD = *(volatile int *) ThreadProgress;
+    if (OLD >= 0)
+      __sync_bool_compare_and_swap(ThreadProgress, OLD, int(Progress));
+#else
+    if (*ThreadProgress >= 0) *ThreadProgress = int(Progress);
+#endif
+  }
+
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::L1BOX(int NP, const int MAP[], int K, double xlo[],
+    double xhi[]) {
+  // Warm start box of an L1 grid search whose I-th coordinate is the
+  // MAP(I)-th component of the solution RM(.,K): the full L2 solution (K=1,
+  // see L1START) for GSOL, the trace-null L2 solution (K=2) for GSOL5 and
+  // the trace-null L1 solution (K=2) for GSOLA. The box is centred at
+  // RM(MAP(I),K) with the half-width of three standard deviations from
+  // COV(.,.,K), but not less than a quarter of the largest component of
+  // RM(.,K) and not more than the original box XLO..XHI. The box may move
+  // by its width over the levels, so the optimum is found unless it lies
+  // further away.
+  double SCALE = 0.0;
+  for (int i = 1; i <= 6; i++)
+    if (fabs(RM[i][K]) > SCALE) SCALE = fabs(RM[i][K]);
+  if (SCALE == 0.0) return;
+  for (int i = 1; i <= NP; i++) {
+    const int j = MAP[i];
+    double HW = 3.0 * sqrt(fabs(COV[j][j][K]));
+    if (!(HW >= 0.25 * SCALE)) HW = 0.25 * SCALE;
+    if (HW > 0.5 * (xhi[i] - xlo[i])) continue;
+    xlo[i] = RM[j][K] - HW;
+    xhi[i] = RM[j][K] + HW;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::L1START(void) {
+  // Full L2 solution RM(.,1) and its covariance COV(.,.,1) for the warm
+  // start of GSOL, computed as in MOM2, which solves only the trace-null
+  // problem for the L1 norm. MOM1 replaces RM(.,1) by the L1 solution.
+  double Z1[9 + 1][9 + 1];
+  Zero(&Z1[0][0], 100);
+  double Z2[9 + 1][9 + 1];
+  Zero(&Z2[0][0], 100);
+  double B[6 + 1];
+  for (int i = 1; i <= 6; i++) {
+    B[i] = 0.0;
+    for (int j = 1; j <= N; j++)
+      B[i] = B[i] + A[j][i] * U[j] * 1.0e+12;
+    for (int j = 1; j <= 6; j++)
+      for (int k = 1; k <= N; k++)
+        Z1[i][j] = Z1[i][j] + A[k][j] * A[k][i];
+  }
+  INVMAT(Z1, Z2, 6);
+  for (int i = 1; i <= 6; i++) {
+    RM[i][1] = 0.0;
+    for (int j = 1; j <= 6; j++)
+      RM[i][1] = RM[i][1] + Z2[i][j] * B[j];
+  }
+
+  Taquart::ChannelMatrix<double, 6 + 1> AA(N);
+  for (int i = 1; i <= N; i++) {
+    double EPS = U[i];
+    double SAI2 = 0.0;
+    for (int j = 1; j <= 6; j++) {
+      EPS = EPS - A[i][j] * RM[j][1] * 1.0e-12;
+      SAI2 = SAI2 + A[i][j] * A[i][j];
+    }
+    for (int j = 1; j <= 6; j++)
+      AA[i][j] = EPS * (A[i][j] / SAI2) * 1.0e+12 + RM[j][1];
+  }
+  for (int i = 1; i <= 6; i++)
+    for (int j = 1; j <= 6; j++) {
+      COV[i][j][1] = 0.0;
+      for (int k = 1; k <= N; k++)
+        COV[i][j][1] = COV[i][j][1]
+            + (AA[k][i] - RM[i][1]) * (AA[k][j] - RM[j][1]);
+      COV[i][j][1] = COV[i][j][1] / double((N - 6) * (N - 6));
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool Taquart::UsmtCore::L1STOP(int NP, const double xlo[],
+    const double xhi[]) {
+  // True if every side of the box is narrower than L1Tolerance times the
+  // largest component of RM(.,2).
+  if (L1Tolerance <= 0.0) return false;
+  const double LIMIT = L1Tolerance * L1SCALE();
+  for (int i = 1; i <= NP; i++)
+    if (xhi[i] - xlo[i] > LIMIT) return false;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool Taquart::UsmtCore::L1HALT(int SEARCH, int LEVEL, int NP,
+    const double xlo[], const double xhi[]) {
+  // True if the grid search SEARCH has to stop after LEVEL levels because
+  // the inversion was cancelled or its deadline expired. The first stop is
+  // recorded in HaltReason, HaltSearch, HaltLevel and HaltWidth.
+  int REASON = 0;
+  if (ThreadProgress && *(volatile int *) ThreadProgress < 0)
+    REASON = 2;
+  else if (DeadlineMs > 0.0 && (WallTime() - StartTime) * 1000.0 > DeadlineMs)
+    REASON = 1;
+  if (REASON == 0) return false;
+  double WIDTH = 0.0;
+  for (int i = 1; i <= NP; i++)
+    if (xhi[i] - xlo[i] > WIDTH) WIDTH = xhi[i] - xlo[i];
+#pragma omp critical (UsmtCoreHalt)
+  if (HaltReason == 0) {
+    HaltReason = REASON;
+    HaltSearch = SEARCH;
+    HaltLevel = LEVEL;
+    HaltWidth = WIDTH;
+  }
+  return true;
+}
 
+//-----------------------------------------------------------------------------
+double Taquart::UsmtCore::L1SCALE(void) {
+  // Largest absolute component of the trace-null solution RM(.,2).
+  double SCALE = 0.0;
+  for (int i = 1; i <= 6; i++)
+    if (fabs(RM[i][2]) > SCALE) SCALE = fabs(RM[i][2]);
+  return SCALE;
 }
 
 //-----------------------------------------------------------------------------
@@ -3730,12 +5094,21 @@ void Taquart::UsmtCore::GSOL(double x[], int &iexp) {
   double xstep[6 + 1];
   Zero(xstep, 7);
   double six = 6.0e+00;
-  double xtry[6 + 1];
   double val = 0.0;
-  double tryy = 0.0;
   //int METH = 1;
   //double size = 0.0;
 
+  // Every coordinate takes only 7 values per level, so the column
+  // contributions COL(K,J,I) = A(I,K)*XTRY(K) are computed once per level and
+  // the partial sums PART(K,I) of A*X are carried down the J1..J6 loop nest.
+  // The partial sums are accumulated in the same order as in F1, hence the
+  // misfit and the selected grid point are the same as in the original code.
+  Taquart::ChannelRows<double, 7 + 1> COL[6 + 1];
+  for (int k = 1; k <= 6; k++)
+    COL[k].Reserve(N);
+  // COL(6,J,I) by stations for the lane kernel, see L1Lanes.
+  std::vector<double> COL6(8 * (N + 1), 0.0);
+
   //      IF((IEXP.LT.10).OR.(IEXP.GT.30)) IEXP=20
   if (iexp < 10 || iexp > 30) iexp = 20;
 
@@ -3755,9 +5128,13 @@ void Taquart::UsmtCore::GSOL(double x[], int &iexp) {
     xhi[i] = pow(10.0, iexp);
     ix[i] = 0;
   }
+  const int MAP[6 + 1] = { 0, 1, 2, 3, 4, 5, 6 };
+  if (L1WarmStart) L1BOX(6, MAP, 1, xlo, xhi);
 
   //      DO 8 L=1,50
   for (int l = 1; l <= 50; l++) {
+    if (l > 1 && L1STOP(6, xlo, xhi)) break;
+    if (l > 1 && L1HALT(1, l - 1, 6, xlo, xhi)) break;
     PROGRESS(l, 350);
     //      do 2 i=1,6
     //    2 xstep(i)=(xhi(i)-xlo(i))/SIX
@@ -3769,63 +5146,119 @@ void Taquart::UsmtCore::GSOL(double x[], int &iexp) {
     //size = xhi[1] - xlo[1];
     iter = iter + 1;
 
-    //      do 3 j1=1,7
-    for (int j1 = 1; j1 <= 7; j1++) {
+    for (int k = 1; k <= 6; k++)
+      for (int j = 1; j <= 7; j++) {
+        const double xk = xlo[k] + double(j - 1) * xstep[k];
+        for (int i = 1; i <= N; i++)
+          COL[k][j][i] = AT[k][i] * xk;
+      }
+    for (int i = 1; i <= N; i++)
+      for (int j = 1; j <= 7; j++)
+        COL6[8 * i + j - 1] = COL[6][j][i];
+
+    // Branch and bound: the subtree below J1..JK is skipped if the lower
+    // bound of its misfit exceeds the best misfit found so far, see L1Bounds.
+    // The bound costs as much as one evaluation of F1, hence it is not used
+    // for the last but one coordinate.
+    Taquart::ChannelRows<double, 6 + 1> CLO(N), CHI(N);
+    double MARGIN = 0.0;
+    if (L1Prune) L1Bounds(6, COL, U, N, CLO, CHI, MARGIN);
+
+    // The 49 (J1,J2) blocks of the level are searched independently, each
+    // from the best misfit of the previous levels, and merged in the loop
+    // order, so the last point with TRY.LE.VAL wins as in the serial code
+    // regardless of the number of threads.
+    double BVAL[49 + 1];
+    int BIX[49 + 1][6 + 1];
+    double BPRUNED[49 + 1];
+    double BVIS[49 + 1][2 + 1];
+#pragma omp parallel for num_threads(GridThreads) schedule(dynamic, 1) if (GridThreads > 1)
+    for (int jb = 1; jb <= 49; jb++) {
+      const int j1 = (jb - 1) / 7 + 1;
+      const int j2 = (jb - 1) % 7 + 1;
+      Taquart::ChannelRows<double, 5 + 1> PART(N);
+      double tryy = 0.0;
+      BVAL[jb] = val;
+      BIX[jb][1] = 0;
+      BPRUNED[jb] = 0.0;
+      BVIS[jb][1] = BVIS[jb][2] = 0.0;
+
+      //      do 3 j1=1,7
       //      xtry(1)=xlo(1)+DBLE(j1-1)*xstep(1)
       //      CALL POSTEP(METH,JTER,J1)
-      xtry[1] = xlo[1] + double(j1 - 1) * xstep[1];
       //POSTEP(METH,jter,j1);
+      for (int i = 1; i <= N; i++)
+        PART[1][i] = COL[1][j1][i];
 
       //      do 3 j2=1,7
-      for (int j2 = 1; j2 <= 7; j2++) {
-        //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
-        xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
-
-        //      do 3 j3=1,7
-        for (int j3 = 1; j3 <= 7; j3++) {
-          //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
-          xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
-
-          //      do 3 j4=1,7
-          for (int j4 = 1; j4 <= 7; j4++) {
-            //      xtry(4)=xlo(4)+DBLE(j4-1)*xstep(4)
-            xtry[4] = xlo[4] + double(j4 - 1) * xstep[4];
-
-            //      do 3 j5=1,7
-            for (int j5 = 1; j5 <= 7; j5++) {
-              //      xtry(5)=xlo(5)+DBLE(j5-1)*xstep(5)
-              xtry[5] = xlo[5] + double(j5 - 1) * xstep[5];
-
-              //      do 3 j6=1,7
-              for (int j6 = 1; j6 <= 7; j6++) {
-                //      xtry(6)=xlo(6)+DBLE(j6-1)*xstep(6)
-                xtry[6] = xlo[6] + double(j6 - 1) * xstep[6];
-                //      call f1(xtry,try)
-                f1(xtry, tryy);
-
-                //      if(try.gt.val) go to 3
-                if (tryy > val) continue;
-
-                //      val=try
-                //      ix(1)=j1
-                //      ix(2)=j2
-                //      ix(3)=j3
-                //      ix(4)=j4
-                //      ix(5)=j5
-                //      ix(6)=j6
-                val = tryy;
-                ix[1] = j1;
-                ix[2] = j2;
-                ix[3] = j3;
-                ix[4] = j4;
-                ix[5] = j5;
-                ix[6] = j6;
-
-                //      do 12 i=1,6
-                //   12 x(i)=SNGL(xtry(i))
-                for (int i = 1; i <= 6; i++)
-                  x[i] = xtry[i];
-              }
+      //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
+      for (int i = 1; i <= N; i++)
+        PART[2][i] = PART[1][i] + COL[2][j2][i];
+      if (L1Prune && BVAL[jb] < 1e+30
+          && L1Lower(PART[2], CLO[2], CHI[2], U, N) > BVAL[jb] + MARGIN) {
+        BPRUNED[jb] = 2401.0;
+        continue;
+      }
+
+      //      do 3 j3=1,7
+      for (int j3 = 1; j3 <= 7; j3++) {
+        //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
+        for (int i = 1; i <= N; i++)
+          PART[3][i] = PART[2][i] + COL[3][j3][i];
+        if (L1Prune && BVAL[jb] < 1e+30
+            && L1Lower(PART[3], CLO[3], CHI[3], U, N) > BVAL[jb] + MARGIN) {
+          BPRUNED[jb] = BPRUNED[jb] + 343.0;
+          continue;
+        }
+
+        //      do 3 j4=1,7
+        for (int j4 = 1; j4 <= 7; j4++) {
+          //      xtry(4)=xlo(4)+DBLE(j4-1)*xstep(4)
+          for (int i = 1; i <= N; i++)
+            PART[4][i] = PART[3][i] + COL[4][j4][i];
+          if (L1Prune && BVAL[jb] < 1e+30
+              && L1Lower(PART[4], CLO[4], CHI[4], U, N) > BVAL[jb] + MARGIN) {
+            BPRUNED[jb] = BPRUNED[jb] + 49.0;
+            continue;
+          }
+
+          //      do 3 j5=1,7
+          for (int j5 = 1; j5 <= 7; j5++) {
+            //      xtry(5)=xlo(5)+DBLE(j5-1)*xstep(5)
+            for (int i = 1; i <= N; i++)
+              PART[5][i] = PART[4][i] + COL[5][j5][i];
+
+            // Without the early exit the 7 points of J6 are evaluated
+            // together, one per lane.
+            double F[8];
+            if (!L1Abandon) L1Lanes(PART[5], 0, &COL6[0], U, N, F);
+
+            //      do 3 j6=1,7
+            for (int j6 = 1; j6 <= 7; j6++) {
+              //      xtry(6)=xlo(6)+DBLE(j6-1)*xstep(6)
+              //      call f1(xtry,try)
+              if (L1Abandon)
+                f1(PART[5], COL[6][j6], tryy, BVAL[jb], BVIS[jb]);
+              else
+                tryy = F[j6 - 1] > 1e+30 ? 1e+30 : F[j6 - 1];
+
+              //      if(try.gt.val) go to 3
+              if (tryy > BVAL[jb]) continue;
+
+              //      val=try
+              //      ix(1)=j1
+              //      ix(2)=j2
+              //      ix(3)=j3
+              //      ix(4)=j4
+              //      ix(5)=j5
+              //      ix(6)=j6
+              BVAL[jb] = tryy;
+              BIX[jb][1] = j1;
+              BIX[jb][2] = j2;
+              BIX[jb][3] = j3;
+              BIX[jb][4] = j4;
+              BIX[jb][5] = j5;
+              BIX[jb][6] = j6;
             }
           }
         }
@@ -3833,6 +5266,21 @@ void Taquart::UsmtCore::GSOL(double x[], int &iexp) {
     }
     //    3 CONTINUE
 
+    for (int jb = 1; jb <= 49; jb++) {
+      L1Pruned[1] = L1Pruned[1] + BPRUNED[jb];
+      L1Visits[1] = L1Visits[1] + BVIS[jb][1];
+      L1Visits[2] = L1Visits[2] + BVIS[jb][2];
+      if (BIX[jb][1] == 0 || BVAL[jb] > val) continue;
+      val = BVAL[jb];
+      for (int i = 1; i <= 6; i++)
+        ix[i] = BIX[jb][i];
+
+      //      do 12 i=1,6
+      //   12 x(i)=SNGL(xtry(i))
+      for (int i = 1; i <= 6; i++)
+        x[i] = xlo[i] + double(ix[i] - 1) * xstep[i];
+    }
+
     //      DO 4 I=1,6
     //      xhi(i)=xlo(i)+DBLE(ix(i)+1)*xstep(i)
     //    4 xlo(i)=xlo(i)+DBLE(ix(i)-3)*xstep(i)
@@ -3842,6 +5290,11 @@ void Taquart::UsmtCore::GSOL(double x[], int &iexp) {
     }
   }
   //    8 CONTINUE
+  L1Levels[1] = L1Levels[1] + iter;
+  L1Levels[2] = L1Levels[2] + 50;
+  L1Points[1] = L1Points[1] + 117649.0 * iter;
+  L1Points[2] = L1Points[2] + 117649.0 * 50;
+  if (L1Prune) L1Pruned[2] = L1Pruned[2] + 117649.0 * iter;
   //      return
   //      end
 }
@@ -3879,14 +5332,325 @@ void Taquart::UsmtCore::f1(double X[], double &fff) {
   //      END
 }
 
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::f1(const double PART[], const double COL[],
+    double &fff) {
+  // F1 evaluated from the partial sum A(I,1..5)*X(1..5) and the column
+  // A(I,6)*X(6) precomputed in GSOL.
+  fff = L1SumF1(PART, COL, U, N);
+  if (fabs(fff) > 1e+30) fff = 1e+30;
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::f1(const double PART[], const double COL[],
+    double &fff, double val, double VIS[]) {
+  // F1 of a grid point compared with the best misfit VAL. With L1Abandon the
+  // sum is abandoned once it exceeds VAL (with a margin for the rounding of
+  // the other order of summation), FFF is then greater than VAL but not the
+  // misfit. The points that pass are evaluated as usual, so the search does
+  // not depend on the kernel. VIS(1) and VIS(2) count the channels visited
+  // and the evaluations.
+  if (!L1Abandon || val >= 1e+30) {
+    f1(PART, COL, fff);
+    return;
+  }
+  int k = 0;
+  const double LIMIT = val + val * 1e-12;
+  fff = L1SumF1Abandon(PART, COL, U, L1ORDER, N, LIMIT, k);
+  VIS[1] = VIS[1] + k;
+  VIS[2] = VIS[2] + 1.0;
+  if (fff > LIMIT) return;
+  f1(PART, COL, fff);
+  VIS[1] = VIS[1] + N;
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::L1MATRX(void) {
+  // Columns of A for the L1 kernels, and the design matrix of the trace-null
+  // problem (M6=-M1-M4) for L1LP and the bounds of GSOL5. F2 itself is summed
+  // from the columns of A, as in the original code.
+  for (int i = 1; i <= N; i++) {
+    for (int k = 1; k <= 6; k++)
+      AT[k][i] = A[i][k];
+    HT[1][i] = A[i][1] - A[i][6];
+    HT[2][i] = A[i][2];
+    HT[3][i] = A[i][3];
+    HT[4][i] = A[i][4] - A[i][6];
+    HT[5][i] = A[i][5];
+  }
+
+  // Order of the channels for the early exit of F1 and F2: the largest
+  // amplitudes usually give the largest residuals.
+  for (int i = 1; i <= N; i++) {
+    int k = i;
+    while (k > 1 && fabs(U[L1ORDER[k - 1]]) < fabs(U[i])) {
+      L1ORDER[k] = L1ORDER[k - 1];
+      k--;
+    }
+    L1ORDER[k] = i;
+  }
+}
+
+//-----------------------------------------------------------------------------
+bool Taquart::UsmtCore::L1LP(int NP, const double * const AM[],
+    double X[]) {
+  // Exact minimum of SUM|AM(.,I)*X-U(I)| over the stations I=1..N, found by
+  // a simplex method in the spirit of Barrodale and Roberts (1973). A vertex
+  // is a set Z of NP stations with zero residuals. Stage 1 builds the first
+  // vertex by bringing one parameter at a time into the basis, stage 2
+  // exchanges stations of Z as long as the misfit decreases. In both stages
+  // the step along an edge is the weighted median of the residual sign
+  // changes, so several vertices are passed in one iteration. Returns false
+  // if the stations do not constrain all NP parameters or if stage 2 does
+  // not reach the optimum in MAXIT iterations (the caller falls back to the
+  // grid search then).
+  int Z[6 + 1];
+  std::vector<bool> INZ(N + 1);
+  bool USED[6 + 1];
+  int P[6 + 1];
+  std::vector<double> R(N + 1), W(N + 1);
+  std::vector<double> T(N + 1);
+  std::vector<int> IDX(N + 1);
+  double M[6 + 1][6 + 1], D[6 + 1], DBEST[6 + 1];
+
+  double UMAX = 0.0;
+  for (int i = 1; i <= N; i++) {
+    INZ[i] = false;
+    if (fabs(U[i]) > UMAX) UMAX = fabs(U[i]);
+  }
+  if (N < NP || UMAX == 0.0) return false;
+  const double RTOL = 1.0e-12 * UMAX;
+
+  for (int j = 1; j <= NP; j++) {
+    X[j] = 0.0;
+    USED[j] = false;
+  }
+
+  // Stage 1.
+  for (int m = 1; m <= NP; m++) {
+    for (int i = 1; i <= N; i++) {
+      R[i] = U[i];
+      for (int j = 1; j <= NP; j++)
+        R[i] = R[i] - AM[j][i] * X[j];
+    }
+
+    int JBEST = 0, IBEST = 0;
+    double FBEST = 0.0, TBEST = 0.0;
+    for (int j = 1; j <= NP; j++) {
+      if (USED[j]) continue;
+      // Direction moving parameter J, the stations of Z keep zero residuals.
+      for (int l = 1; l <= NP; l++)
+        D[l] = 0.0;
+      D[j] = 1.0;
+      if (m > 1) {
+        double b[6 + 1];
+        for (int q = 1; q < m; q++) {
+          for (int l = 1; l < m; l++)
+            M[q][l] = AM[P[l]][Z[q]];
+          b[q] = -AM[j][Z[q]];
+        }
+        if (!L1LPSOLVE(M, b, m - 1)) continue;
+        for (int l = 1; l < m; l++)
+          D[P[l]] = b[l];
+      }
+
+      int NT = 0;
+      double WMAX = 0.0, WSUM = 0.0;
+      for (int i = 1; i <= N; i++) {
+        W[i] = 0.0;
+        if (INZ[i]) continue;
+        for (int l = 1; l <= NP; l++)
+          W[i] = W[i] + AM[l][i] * D[l];
+        if (fabs(W[i]) > WMAX) WMAX = fabs(W[i]);
+      }
+      for (int i = 1; i <= N; i++) {
+        if (INZ[i] || fabs(W[i]) <= 1.0e-12 * WMAX) continue;
+        NT = NT + 1;
+        T[NT] = R[i] / W[i];
+        IDX[NT] = i;
+        WSUM = WSUM + fabs(W[i]);
+      }
+      if (NT == 0) continue;
+      L1LPSORT(&T[0], &IDX[0], NT);
+
+      // Weighted median of the breakpoints minimizes the misfit on the line.
+      int k = 1;
+      double WCUM = fabs(W[IDX[1]]);
+      while (k < NT && 2.0 * WCUM < WSUM) {
+        k = k + 1;
+        WCUM = WCUM + fabs(W[IDX[k]]);
+      }
+      double F = 0.0;
+      for (int i = 1; i <= N; i++)
+        if (!INZ[i]) F = F + fabs(R[i] - T[k] * W[i]);
+      if (JBEST == 0 || F < FBEST) {
+        JBEST = j;
+        IBEST = IDX[k];
+        FBEST = F;
+        TBEST = T[k];
+        for (int l = 1; l <= NP; l++)
+          DBEST[l] = D[l];
+      }
+    }
+    if (JBEST == 0) return false;
+
+    for (int l = 1; l <= NP; l++)
+      X[l] = X[l] + TBEST * DBEST[l];
+    USED[JBEST] = true;
+    P[m] = JBEST;
+    Z[m] = IBEST;
+    INZ[IBEST] = true;
+  }
+
+  // Stage 2.
+  const int MAXIT = 20 * N + 100;
+  for (int it = 1; it <= MAXIT; it++) {
+    // Vertex and the edge directions: column Q of the inverse of A(Z,.)
+    // changes the residual of station Z(Q) only.
+    double INV[6 + 1][6 + 1];
+    for (int q = 1; q <= NP; q++) {
+      double b[6 + 1];
+      for (int l = 1; l <= NP; l++) {
+        for (int c = 1; c <= NP; c++)
+          M[l][c] = AM[c][Z[l]];
+        b[l] = (l == q) ? 1.0 : 0.0;
+      }
+      if (!L1LPSOLVE(M, b, NP)) return false;
+      for (int l = 1; l <= NP; l++)
+        INV[l][q] = b[l];
+    }
+    for (int l = 1; l <= NP; l++) {
+      X[l] = 0.0;
+      for (int q = 1; q <= NP; q++)
+        X[l] = X[l] + INV[l][q] * U[Z[q]];
+    }
+    for (int i = 1; i <= N; i++) {
+      R[i] = U[i];
+      for (int j = 1; j <= NP; j++)
+        R[i] = R[i] - AM[j][i] * X[j];
+    }
+
+    int QBEST = 0;
+    double SBEST = -1.0e-10, SIGN = 1.0;
+    for (int q = 1; q <= NP; q++) {
+      double SP = 1.0, SM = 1.0;
+      for (int i = 1; i <= N; i++) {
+        if (INZ[i]) continue;
+        double w = 0.0;
+        for (int l = 1; l <= NP; l++)
+          w = w + AM[l][i] * INV[l][q];
+        if (fabs(R[i]) <= RTOL) {
+          SP = SP + fabs(w);
+          SM = SM + fabs(w);
+        }
+        else {
+          SP = SP - (R[i] > 0.0 ? w : -w);
+          SM = SM + (R[i] > 0.0 ? w : -w);
+        }
+      }
+      if (SP < SBEST) {
+        SBEST = SP;
+        QBEST = q;
+        SIGN = 1.0;
+      }
+      if (SM < SBEST) {
+        SBEST = SM;
+        QBEST = q;
+        SIGN = -1.0;
+      }
+    }
+    if (QBEST == 0) return true;
+
+    // Line search: the slope grows by 2|W| at every breakpoint.
+    int NT = 0;
+    for (int i = 1; i <= N; i++) {
+      W[i] = 0.0;
+      if (INZ[i]) continue;
+      for (int l = 1; l <= NP; l++)
+        W[i] = W[i] + AM[l][i] * INV[l][QBEST] * SIGN;
+      if (fabs(R[i]) <= RTOL || W[i] == 0.0) continue;
+      if (R[i] / W[i] < 0.0) continue;
+      NT = NT + 1;
+      T[NT] = R[i] / W[i];
+      IDX[NT] = i;
+    }
+    if (NT == 0) return false;
+    L1LPSORT(&T[0], &IDX[0], NT);
+    double SLOPE = SBEST;
+    int k = 0;
+    while (k < NT && SLOPE < 0.0) {
+      k = k + 1;
+      SLOPE = SLOPE + 2.0 * fabs(W[IDX[k]]);
+    }
+    INZ[Z[QBEST]] = false;
+    Z[QBEST] = IDX[k];
+    INZ[IDX[k]] = true;
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+bool Taquart::UsmtCore::L1LPSOLVE(double M[][6 + 1], double b[], int n) {
+  // Gaussian elimination with partial pivoting, M*x=b, x returned in b.
+  double SCALE = 0.0;
+  for (int i = 1; i <= n; i++)
+    for (int j = 1; j <= n; j++)
+      if (fabs(M[i][j]) > SCALE) SCALE = fabs(M[i][j]);
+  if (SCALE == 0.0) return false;
+  for (int k = 1; k <= n; k++) {
+    int IMAX = k;
+    for (int i = k + 1; i <= n; i++)
+      if (fabs(M[i][k]) > fabs(M[IMAX][k])) IMAX = i;
+    if (fabs(M[IMAX][k]) <= 1.0e-13 * SCALE) return false;
+    if (IMAX != k) {
+      for (int j = 1; j <= n; j++) {
+        const double DUM = M[k][j];
+        M[k][j] = M[IMAX][j];
+        M[IMAX][j] = DUM;
+      }
+      const double DUM = b[k];
+      b[k] = b[IMAX];
+      b[IMAX] = DUM;
+    }
+    for (int i = k + 1; i <= n; i++) {
+      const double F = M[i][k] / M[k][k];
+      for (int j = k; j <= n; j++)
+        M[i][j] = M[i][j] - F * M[k][j];
+      b[i] = b[i] - F * b[k];
+    }
+  }
+  for (int k = n; k >= 1; k--) {
+    for (int j = k + 1; j <= n; j++)
+      b[k] = b[k] - M[k][j] * b[j];
+    b[k] = b[k] / M[k][k];
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::L1LPSORT(double T[], int IDX[], int n) {
+  // Insertion sort of the breakpoints T(1..N) together with their stations.
+  for (int i = 2; i <= n; i++) {
+    const double TT = T[i];
+    const int II = IDX[i];
+    int j = i - 1;
+    while (j >= 1 && T[j] > TT) {
+      T[j + 1] = T[j];
+      IDX[j + 1] = IDX[j];
+      j = j - 1;
+    }
+    T[j + 1] = TT;
+    IDX[j + 1] = II;
+  }
+}
+
 //-----------------------------------------------------------------------------
 void Taquart::UsmtCore::GSOL5(double x[], int &IEXP) {
   //      subroutine gsol5(x,IEXP)
   //      dimension x(5),ix(5)
   //      double precision xlo(5),xhi(5),xstep(5),six,size,xtry(5),VAL,TRY
   //      DATA SIX,METH/6.D+0,2/
-  double xlo[5 + 1], xhi[5 + 1], xstep[5 + 1], six = 6.0, xtry[5], VAL = 0.0,
-      TRY = 0.0;
+  double xlo[5 + 1], xhi[5 + 1], xstep[5 + 1], six = 6.0, VAL = 0.0;
   //int METH = 2;
   int ix[5 + 1];
 
@@ -3908,9 +5672,15 @@ void Taquart::UsmtCore::GSOL5(double x[], int &IEXP) {
     ix[i] = 0;
   }
   //    1 ix(i)=0
+  const int MAP[5 + 1] = { 0, 1, 2, 3, 4, 5 };
+  if (L1WarmStart) L1BOX(5, MAP, 2, xlo, xhi);
+  // A(I,5)*XTRY(5) of the 7 points of J5 by stations, see L1Lanes.
+  std::vector<double> COL5(8 * (N + 1), 0.0);
 
   //      DO 8 L=1,50
   for (int l = 1; l <= 50; l++) {
+    if (l > 1 && L1STOP(5, xlo, xhi)) break;
+    if (l > 1 && L1HALT(2, l - 1, 5, xlo, xhi)) break;
     PROGRESS(l + 50, 350);
 
     //      do 2 i=1,5
@@ -3920,60 +5690,148 @@ void Taquart::UsmtCore::GSOL5(double x[], int &IEXP) {
 
     //      size=xhi(1)-xlo(1)
     //      iter=iter+1
-    //      do 3 j1=1,7
     //size = xhi[1] - xlo[1];
     iter = iter + 1;
-    for (int j1 = 1; j1 <= 7; j1++) {
+    for (int j = 1; j <= 7; j++) {
+      const double x5 = xlo[5] + double(j - 1) * xstep[5];
+      for (int i = 1; i <= N; i++)
+        COL5[8 * i + j - 1] = AT[5][i] * x5;
+    }
+
+    // Branch and bound as in GSOL. The columns HT(K,I)*XTRY(K) and the
+    // partial sums are only needed for the bounds, F2 is evaluated as usual.
+    Taquart::ChannelRows<double, 7 + 1> COL[5 + 1];
+    Taquart::ChannelRows<double, 5 + 1> CLO, CHI;
+    double MARGIN = 0.0;
+    if (L1Prune) {
+      CLO.Reserve(N);
+      CHI.Reserve(N);
+      for (int k = 1; k <= 5; k++) {
+        COL[k].Reserve(N);
+        for (int j = 1; j <= 7; j++) {
+          const double xk = xlo[k] + double(j - 1) * xstep[k];
+          for (int i = 1; i <= N; i++)
+            COL[k][j][i] = HT[k][i] * xk;
+        }
+      }
+      L1Bounds(5, COL, U, N, CLO, CHI, MARGIN);
+    }
+
+    // The 49 (J1,J2) blocks of the level are searched independently, each
+    // from the best misfit of the previous levels, and merged in the loop
+    // order, so the last point with TRY.LE.VAL wins as in the serial code
+    // regardless of the number of threads.
+    double BVAL[49 + 1];
+    int BIX[49 + 1][5 + 1];
+    double BPRUNED[49 + 1];
+    double BVIS[49 + 1][2 + 1];
+#pragma omp parallel for num_threads(GridThreads) schedule(dynamic, 1) if (GridThreads > 1)
+    for (int jb = 1; jb <= 49; jb++) {
+      const int j1 = (jb - 1) / 7 + 1;
+      const int j2 = (jb - 1) % 7 + 1;
+      double xtry[5 + 1], TRY = 0.0;
+      Taquart::ChannelRows<double, 3 + 1> PART(L1Prune ? N : 0);
+      std::vector<double> Q(L1Abandon ? 0 : N + 1);
+      std::vector<double> C(L1Abandon ? 0 : N + 1);
+      BVAL[jb] = VAL;
+      BIX[jb][1] = 0;
+      BPRUNED[jb] = 0.0;
+      BVIS[jb][1] = BVIS[jb][2] = 0.0;
+
+      //      do 3 j1=1,7
       //      xtry(1)=xlo(1)+DBLE(j1-1)*xstep(1)
       //      CALL POSTEP(METH,JTER,J1)
       xtry[1] = xlo[1] + double(j1 - 1) * xstep[1];
       //POSTEP(METH,jter,j1);
 
       //      do 3 j2=1,7
-      for (int j2 = 1; j2 <= 7; j2++) {
-        //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
-        //      do 3 j3=1,7
-        xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
-        for (int j3 = 1; j3 <= 7; j3++) {
-          //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
-          //      do 3 j4=1,7
-          xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
-          for (int j4 = 1; j4 <= 7; j4++) {
-            //      xtry(4)=xlo(4)+DBLE(j4-1)*xstep(4)
-            //      do 3 j5=1,7
-            xtry[4] = xlo[4] + double(j4 - 1) * xstep[4];
-            for (int j5 = 1; j5 <= 7; j5++) {
-              //      xtry(5)=xlo(5)+DBLE(j5-1)*xstep(5)
-              //      call f2(xtry,try)
-              xtry[5] = xlo[5] + double(j5 - 1) * xstep[5];
-              f2(xtry, TRY);
-
-              //      if(try.gt.val) go to 3
-              if (TRY > VAL) continue;
-
-              //      val=try
-              //      ix(1)=j1
-              //      ix(2)=j2
-              //      ix(3)=j3
-              //      ix(4)=j4
-              //      ix(5)=j5
-              //      do 12 i=1,5
-              //   12 x(i)=SNGL(Xtry(i))
-              VAL = TRY;
-              ix[1] = j1;
-              ix[2] = j2;
-              ix[3] = j3;
-              ix[4] = j4;
-              ix[5] = j5;
-              for (int i = 1; i <= 5; i++) {
-                x[i] = xtry[i];
-              }
+      //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
+      xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
+      if (L1Prune) {
+        for (int i = 1; i <= N; i++)
+          PART[2][i] = COL[1][j1][i] + COL[2][j2][i];
+        if (BVAL[jb] < 1e+30
+            && L1Lower(PART[2], CLO[2], CHI[2], U, N) > BVAL[jb] + MARGIN) {
+          BPRUNED[jb] = 343.0;
+          continue;
+        }
+      }
+      //      do 3 j3=1,7
+      for (int j3 = 1; j3 <= 7; j3++) {
+        //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
+        //      do 3 j4=1,7
+        xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
+        if (L1Prune) {
+          for (int i = 1; i <= N; i++)
+            PART[3][i] = PART[2][i] + COL[3][j3][i];
+          if (BVAL[jb] < 1e+30
+              && L1Lower(PART[3], CLO[3], CHI[3], U, N) > BVAL[jb] + MARGIN) {
+            BPRUNED[jb] = BPRUNED[jb] + 49.0;
+            continue;
+          }
+        }
+        for (int j4 = 1; j4 <= 7; j4++) {
+          //      xtry(4)=xlo(4)+DBLE(j4-1)*xstep(4)
+          //      do 3 j5=1,7
+          xtry[4] = xlo[4] + double(j4 - 1) * xstep[4];
+
+          // Without the early exit the 7 points of J5 are evaluated
+          // together, one per lane: the sum of F2 is split into
+          // A(I,1..4)*X(1..4), the column A(I,5)*X(5) and A(I,6)*(X(1)+X(4)).
+          double F[8];
+          if (!L1Abandon) {
+            for (int i = 1; i <= N; i++) {
+              Q[i] = AT[1][i] * xtry[1] + AT[2][i] * xtry[2]
+                  + AT[3][i] * xtry[3] + AT[4][i] * xtry[4];
+              C[i] = AT[6][i] * (xtry[1] + xtry[4]);
             }
+            L1Lanes(&Q[0], &C[0], &COL5[0], U, N, F);
+          }
+          for (int j5 = 1; j5 <= 7; j5++) {
+            //      xtry(5)=xlo(5)+DBLE(j5-1)*xstep(5)
+            //      call f2(xtry,try)
+            xtry[5] = xlo[5] + double(j5 - 1) * xstep[5];
+            if (L1Abandon)
+              f2(xtry, TRY, BVAL[jb], BVIS[jb]);
+            else
+              TRY = F[j5 - 1] > 1.0e+30 ? 1.0e+30 : F[j5 - 1];
+
+            //      if(try.gt.val) go to 3
+            if (TRY > BVAL[jb]) continue;
+
+            //      val=try
+            //      ix(1)=j1
+            //      ix(2)=j2
+            //      ix(3)=j3
+            //      ix(4)=j4
+            //      ix(5)=j5
+            BVAL[jb] = TRY;
+            BIX[jb][1] = j1;
+            BIX[jb][2] = j2;
+            BIX[jb][3] = j3;
+            BIX[jb][4] = j4;
+            BIX[jb][5] = j5;
           }
         }
       }
     }
     //    3 CONTINUE
+
+    for (int jb = 1; jb <= 49; jb++) {
+      L1Pruned[1] = L1Pruned[1] + BPRUNED[jb];
+      L1Visits[1] = L1Visits[1] + BVIS[jb][1];
+      L1Visits[2] = L1Visits[2] + BVIS[jb][2];
+      if (BIX[jb][1] == 0 || BVAL[jb] > VAL) continue;
+      VAL = BVAL[jb];
+      for (int i = 1; i <= 5; i++)
+        ix[i] = BIX[jb][i];
+
+      //      do 12 i=1,5
+      //   12 x(i)=SNGL(Xtry(i))
+      for (int i = 1; i <= 5; i++)
+        x[i] = xlo[i] + double(ix[i] - 1) * xstep[i];
+    }
+
     //      DO 4 I=1,5
     //      xhi(i)=xlo(i)+DBLE(ix(i)+1)*xstep(i)
     //    4 xlo(i)=xlo(i)+DBLE(ix(i)-3)*xstep(i)
@@ -3983,6 +5841,11 @@ void Taquart::UsmtCore::GSOL5(double x[], int &IEXP) {
     }
   }
   //    8 CONTINUE
+  L1Levels[1] = L1Levels[1] + iter;
+  L1Levels[2] = L1Levels[2] + 50;
+  L1Points[1] = L1Points[1] + 16807.0 * iter;
+  L1Points[2] = L1Points[2] + 16807.0 * 50;
+  if (L1Prune) L1Pruned[2] = L1Pruned[2] + 16807.0 * iter;
   //      return
   //      end
 }
@@ -3994,18 +5857,13 @@ void Taquart::UsmtCore::GSOLA(double x[], int &IEXP) {
   //      dimension x(5),ix(4),xmem(5,5),vmem(5)
   //      DATA TWO,FOUR,METH,SIX/2.D+0,4.D+0,3,6.D+0/
 
-  double xlo[4 + 1];
-  Zero(xlo, 5);
-  double xhi[4 + 1];
-  Zero(xhi, 5);
-  double xstep[4 + 1];
-  Zero(xstep, 5);
-  double xtry[5 + 1];
-  Zero(xtry, 6);
-  double FOUR = 4.0, SIX = 6.0, val = 0.0, tryy = 0.0;
-  double help, y[5 + 1], DEL = 0.0, TWO = 2.0;
-  int ix[4 + 1];
+  double xtry[5 + 1][5 + 1];
+  Zero(&xtry[0][0], 36);
+  bool found[5 + 1];
   double xmem[5 + 1][5 + 1], vmem[5 + 1];
+  int levels[5 + 1];
+  double visits[5 + 1][2 + 1];
+  Zero(&visits[0][0], 18);
   Zero(&xmem[0][0], 36);
   Zero(vmem, 6);
   //int METH = 3;
@@ -4015,8 +5873,6 @@ void Taquart::UsmtCore::GSOLA(double x[], int &IEXP) {
   //      iter=0
   //      jter=1
   if (IEXP < 10 || IEXP > 30) IEXP = 20;
-  double ZERO = 0.0;
-  int iter = 0;
   //int jter = 1;
   //      do 5 i=1,5
   //      vmem(i)=1.e+30
@@ -4028,24 +5884,108 @@ void Taquart::UsmtCore::GSOLA(double x[], int &IEXP) {
       xmem[i][j] = 0.0;
   }
 
-  //C     Search for X1,X2,X3,X4; X5 is calculated:
-  //      val=1.d+30
-  //      do 1 i=1,4
-  //      xlo(i)=DBLE(-1.*10.**IEXP)
-  //      xhi(i)=DBLE(10.**IEXP)
-  //    1 ix(i)=0
-  val = 1e+30;
-  for (int i = 1; i <= 4; i++) {
-    xlo[i] = -1.0 * pow(10.0, IEXP);
-    xhi[i] = pow(10.0, IEXP);
-    ix[i] = 0;
+  // Sub-search K looks for four of the components, X(6-K) is calculated
+  // from the det=0 condition (see GSOLAB).
+  // The sub-searches only meet in the selection below, except for X4 which
+  // the fifth one takes over from the fourth. With more than one thread they
+  // run as four concurrent tasks, the fourth followed by the fifth, each with
+  // its own XTRY (the nested levels then run serially). The chain 4-5 is
+  // handed out first.
+  if (GridThreads > 1) {
+#pragma omp parallel for num_threads(GridThreads < 4 ? GridThreads : 4) schedule(dynamic, 1)
+    for (int K = 4; K >= 1; K--) {
+      found[K] = GSOLAS(K, IEXP, xtry[K], xmem[K], vmem[K], levels[K],
+          visits[K], false);
+      if (K == 4) found[5] = GSOLAS(5, IEXP, xtry[4], xmem[5], vmem[5],
+          levels[5], visits[5], false);
+    }
+    PROGRESS(350, 350);
+  }
+  else {
+    for (int K = 1; K <= 5; K++)
+      found[K] = GSOLAS(K, IEXP, xtry[1], xmem[K], vmem[K], levels[K],
+          visits[K], true);
   }
 
+  // A sub-search without a solution stops after the first level, as the
+  // original one.
+  for (int K = 1; K <= 5; K++) {
+    L1Levels[1] = L1Levels[1] + levels[K];
+    L1Levels[2] = L1Levels[2] + (found[K] ? 50 : levels[K]);
+    L1Points[1] = L1Points[1] + 2401.0 * levels[K];
+    L1Points[2] = L1Points[2] + 2401.0 * (found[K] ? 50 : levels[K]);
+    L1Visits[1] = L1Visits[1] + visits[K][1];
+    L1Visits[2] = L1Visits[2] + visits[K][2];
+  }
+
+  // X is left by the last successful sub-search, as in the original code.
+  for (int K = 1; K <= 5; K++)
+    if (found[K]) for (int i = 1; i <= 5; i++)
+      x[i] = xmem[K][i];
+
+  //  430 DO 31 I=1,4
+  for (int i = 1; i <= 4; i++) {
+    //      IF(VMEM(I).GT.VMEM(5)) GO TO 31
+    //      VMEM(5)=VMEM(I)
+    //      DO 32 J=1,5
+    //   32 X(J)=XMEM(I,J)
+    if (vmem[i] > vmem[5]) break;
+    vmem[5] = vmem[i];
+    for (int j = 1; j <= 5; j++)
+      x[j] = xmem[i][j];
+  }
+  //   31 CONTINUE
+  //      return
+  //      END
+}
+
+//-----------------------------------------------------------------------------
+bool Taquart::UsmtCore::GSOLAS(int K, int IEXP, double xtry[], double xmem[],
+    double &vmem, int &levels, double VIS[], bool Report) {
+  // K-th sub-search of GSOLA (labels 1-30, 101-130, ..., 401-430 of the
+  // original code). Returns false and leaves XMEM and VMEM unchanged when no
+  // point satisfies the det=0 constraint on the first level. The fifth
+  // sub-search keeps X4 left in XTRY by the fourth, as in the original code.
+  // The number of levels is returned in LEVELS, the channels visited and the
+  // evaluations are added to VIS(1) and VIS(2) and progress is reported only
+  // if REPORT is set.
+  double xlo[4 + 1];
+  Zero(xlo, 5);
+  double xhi[4 + 1];
+  Zero(xhi, 5);
+  double xstep[4 + 1];
+  Zero(xstep, 5);
+  double SIX = 6.0, val = 0.0;
+  int ix[4 + 1];
+  double x[5 + 1];
+  Zero(x, 6);
+  int iter = 0;
+
+  //      val=1.d+30
+  //      do 1 i=1,4
+  //      xlo(i)=DBLE(-1.*10.**IEXP)
+  //      xhi(i)=DBLE(10.**IEXP)
+  //    1 ix(i)=0
+  val = 1e+30;
+  for (int i = 1; i <= 4; i++) {
+    xlo[i] = -1.0 * pow(10.0, IEXP);
+    xhi[i] = pow(10.0, IEXP);
+    ix[i] = 0;
+  }
+  // Components searched by the sub-search (the fifth sets X2 twice).
+  static const int MAP[5 + 1][4 + 1] = { { 0, 0, 0, 0, 0 },
+      { 0, 1, 2, 3, 4 }, { 0, 1, 2, 3, 5 }, { 0, 1, 2, 4, 5 },
+      { 0, 1, 3, 4, 5 }, { 0, 2, 2, 3, 5 } };
+  if (L1WarmStart) L1BOX(4, MAP[K], 2, xlo, xhi);
+  levels = 0;
+
   //int j7 = 0;
 
   //      DO 8 L=1,50
   for (int l = 1; l <= 50; l++) {
-    PROGRESS(l + 100, 350);
+    if (l > 1 && L1STOP(4, xlo, xhi)) break;
+    if (l > 1 && L1HALT(3, l - 1, 4, xlo, xhi)) break;
+    if (Report) PROGRESS(l + 50 + 50 * K, 350);
     //      do 2 i=1,4
     //    2 xstep(i)=(xhi(i)-xlo(i))/SIX
     for (int i = 1; i <= 4; i++)
@@ -4057,123 +5997,52 @@ void Taquart::UsmtCore::GSOLA(double x[], int &IEXP) {
     //      J7=7
     //SIZE = xhi[1] - xlo[1];
     iter++;
-    xtry[5] = 0.0;
+    levels = iter;
+    xtry[6 - K] = 0.0;
     //j7 = 7;
 
     //      CALL POSTEP(METH,JTER,J7)
     //POSTEP(METH,jter,j7);
 
-    //      do 3 j1=1,7
-    for (int j1 = 1; j1 <= 7; j1++) {
-      //      xtry(1)=xlo(1)+DBLE(j1-1)*xstep(1)
-      xtry[1] = xlo[1] + double(j1 - 1) * xstep[1];
-      //      do 3 j2=1,7
-      for (int j2 = 1; j2 <= 7; j2++) {
-        //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
-        xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
-        //      do 3 j3=1,7
-        for (int j3 = 1; j3 <= 7; j3++) {
-          //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
-          xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
-          //      do 3 j4=1,7
-          for (int j4 = 1; j4 <= 7; j4++) {
-            //      xtry(4)=xlo(4)+DBLE(j4-1)*xstep(4)
-            xtry[4] = xlo[4] + double(j4 - 1) * xstep[4];
-
-            //      if(dabs(xtry(1)).lt.1.d-6) go to 23
-            if (fabs(xtry[1]) < 1.0e-6) goto p23;
-
-            //      do 21 i=1,5
-            //   21 y(i)=xtry(i)*1.d-10
-            for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      DEL=(TWO*y(2)*y(3))**2+FOUR*Y(1)*(Y(4)*(-Y(1)**2-Y(1)*Y(4)-
-            //     $Y(3)**2+Y(2)**2)+Y(2)**2*Y(1))
-            DEL = pow(TWO * y[2] * y[3], 2.0)
-                + FOUR * y[1]
-                    * (y[4]
-                        * (-pow(y[1], 2.0) - y[1] * y[4] - pow(y[3], 2.0)
-                            + pow(y[2], 2.0)) + pow(y[2], 2.0) * y[1]);
-
-            //      IF(DEL.LT.ZERO) GO TO 3
-            if (DEL < ZERO) continue;
-
-            //      DEL=DSQRT(DEL)
-            //      Y(5)=(TWO*Y(2)*Y(3)+DEL)/TWO/Y(1)
-            //      XTRY(5)=Y(5)*1.D+10
-            //      call f2(xtry,try)
-            DEL = sqrt(DEL);
-            y[5] = (TWO * y[2] * y[3] + DEL) / TWO / y[1];
-            xtry[5] = y[5] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      IF(TRY.GT.VAL) GO TO 22
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            if (tryy > val) goto p22;
-            RENUM(tryy, val, ix, j1, j2, j3, j4);
-
-            //      DO 12 i=1,5
-            //   12 x(i)=SNGL(XTRY(I))
-            for (int i = 1; i <= 5; i++)
-              x[i] = double(xtry[i]);
-
-            //   22 Y(5)=(TWO*Y(2)*Y(3)-DEL)/TWO/Y(1)
-            //      XTRY(5)=Y(5)*1.D+10
-            //      call f2(xtry,try)
-            p22: y[5] = (TWO * y[2] * y[3] - DEL) / TWO / y[1];
-            xtry[5] = y[5] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      IF(TRY.GT.VAL) GO TO 3
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            if (tryy > val) continue;
-            RENUM(tryy, val, ix, j1, j2, j3, j4);
-
-            //      DO 25 i=1,5
-            //   25 x(i)=SNGL(xtry(i))
-            for (int i = 1; i <= 5; i++)
-              x[i] = double(xtry[i]);
-            //      go to 3
-            continue;
-
-            //   23 if((DABS(XTRY(2)).lt.1.d-6).OR.(DABS(XTRY(3)).LT.1.d-6)) GO TO 3
-            p23: if (fabs(xtry[2]) < 1.0e-6 || fabs(xtry[3]) < 1.0e-6) continue;
-
-            //      DO 27 i=1,5
-            //   27 y(i)=xtry(i)*1.d-10
-            for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      DEL=Y(4)*(-Y(1)**2-Y(1)*Y(4)-Y(3)**2+Y(2)**2)+Y(2)**2*Y(1)
-
-            DEL = y[4]
-                * (-pow(y[1], 2.0) - y[1] * y[4] - pow(y[3], 2.0)
-                    + pow(y[2], 2.0)) + pow(y[2], 2.0) * y[1];
-
-            //      Y(5)=-DEL/TWO/Y(3)/Y(2)
-            //      XTRY(5)=Y(5)*1.d+10
-            //      call f2(xtry,try)
-            y[5] = -DEL / TWO / y[3] / y[2];
-            xtry[5] = y[5] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      if(try.gt.val) go to 3
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      do 28 i=1,5
-            //   28 x(i)=SNGL(xtry(i))
-            if (tryy > val) continue;
-            RENUM(tryy, val, ix, j1, j2, j3, j4);
-            for (int i = 1; i <= 5; i++)
-              x[i] = double(xtry[i]);
-          }
-        }
-      }
+    // The 49 (J1,J2) blocks of the level are searched independently, each
+    // from the best misfit of the previous levels, and merged in the loop
+    // order, so the last point with TRY.LE.VAL wins as in the serial code
+    // regardless of the number of threads. XTRY is left as by the last
+    // block.
+    double BVAL[49 + 1];
+    int BIX[49 + 1][4 + 1];
+    double BX[49 + 1][5 + 1];
+    double BTRY[5 + 1];
+    double BVIS[49 + 1][2 + 1];
+#pragma omp parallel for num_threads(GridThreads) schedule(dynamic, 1) if (GridThreads > 1)
+    for (int jb = 1; jb <= 49; jb++) {
+      double xt[5 + 1];
+      for (int i = 1; i <= 5; i++)
+        xt[i] = xtry[i];
+      BVAL[jb] = val;
+      BIX[jb][1] = 0;
+      BVIS[jb][1] = BVIS[jb][2] = 0.0;
+      GSOLAB(K, (jb - 1) / 7 + 1, (jb - 1) % 7 + 1, xlo, xstep, xt, BVAL[jb],
+          BIX[jb], BX[jb], BVIS[jb]);
+      if (jb == 49) for (int i = 1; i <= 5; i++)
+        BTRY[i] = xt[i];
+    }
+    for (int i = 1; i <= 5; i++)
+      xtry[i] = BTRY[i];
+    for (int jb = 1; jb <= 49; jb++) {
+      VIS[1] = VIS[1] + BVIS[jb][1];
+      VIS[2] = VIS[2] + BVIS[jb][2];
+      if (BIX[jb][1] == 0 || BVAL[jb] > val) continue;
+      val = BVAL[jb];
+      for (int i = 1; i <= 4; i++)
+        ix[i] = BIX[jb][i];
+      for (int i = 1; i <= 5; i++)
+        x[i] = BX[jb][i];
     }
     //    3 continue
 
     //      if(val.eq.1.d+30) go to 30
-    if (val == 1e+30) goto p30;
+    if (val == 1e+30) return false;
     //      DO 4 I=1,4
     //      xhi(i)=xlo(i)+DBLE(ix(i)+1)*xstep(i)
     //    4 xlo(i)=xlo(i)+DBLE(ix(i)-3)*xstep(i)
@@ -4188,651 +6057,554 @@ void Taquart::UsmtCore::GSOLA(double x[], int &IEXP) {
   //   29 XMEM(1,I)=X(I)
   //      VMEM(1)=SNGL(VAL)
   for (int i = 1; i <= 5; i++)
-    xmem[1][i] = x[i];
-  vmem[1] = val;
-
-  //C     Search for X1,X2,X3,X5; X4 is calculated:
-  //   30 val=1.d+30
-  //      do 101 i=1,4
-  //      xlo(i)=DBLE(-1.*10.**IEXP)
-  //      xhi(i)=DBLE(10.**IEXP)
-  //  101 ix(i)=0
-  p30: val = 1.0e+30;
-  for (int i = 1; i <= 4; i++) {
-    xlo[i] = -1.0 * pow(10, IEXP);
-    xhi[i] = pow(10, IEXP);
-    ix[i] = 0;
-  }
-
-  //      DO 108 l=1,50
-  for (int l = 1; l <= 50; l++) {
-    PROGRESS(l + 150, 350);
-    //      do 102 i=1,4
-    //  102 xstep(i)=(xhi(i)-xlo(i))/SIX
-    for (int i = 1; i <= 4; i++)
-      xstep[i] = (xhi[i] - xlo[i]) / SIX;
-
-    //      size=xhi(1)-xlo(1)
-    //      iter=iter+1
-    //      xtry(4)=DBLE(0.)
-    //      CALL POSTEP(METH,JTER,J7)
-    //SIZE = xhi[1] - xlo[1];
-    iter++;
-    xtry[4] = 0.0;
-    //POSTEP(METH,jter,j7);
+    xmem[i] = x[i];
+  vmem = val;
+  return true;
+}
 
-    //      do 103 j1=1,7
-    for (int j1 = 1; j1 <= 7; j1++) {
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::GSOLAB(int K, int j1, int j2, const double xlo[],
+    const double xstep[], double xtry[], double &val, int ix[], double x[],
+    double VIS[]) {
+  // Block (J1,J2) of one level of the K-th sub-search of GSOLA, i.e. the J3
+  // and J4 loops of the original code. VAL, IX and X are updated as in the
+  // serial loop nest, VIS as in F2.
+  double FOUR = 4.0, TWO = 2.0, ZERO = 0.0, tryy = 0.0;
+  double help, y[5 + 1], DEL = 0.0;
+
+  switch (K) {
+    case 1:
+      //C     Search for X1,X2,X3,X4; X5 is calculated:
+      //      do 3 j1=1,7
+      //      xtry(1)=xlo(1)+DBLE(j1-1)*xstep(1)
+      xtry[1] = xlo[1] + double(j1 - 1) * xstep[1];
+      //      do 3 j2=1,7
+      //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
+      xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
+      //      do 3 j3=1,7
+      for (int j3 = 1; j3 <= 7; j3++) {
+        //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
+        xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
+        //      do 3 j4=1,7
+        for (int j4 = 1; j4 <= 7; j4++) {
+          //      xtry(4)=xlo(4)+DBLE(j4-1)*xstep(4)
+          xtry[4] = xlo[4] + double(j4 - 1) * xstep[4];
+
+          //      if(dabs(xtry(1)).lt.1.d-6) go to 23
+          if (fabs(xtry[1]) < 1.0e-6) goto p23;
+
+          //      do 21 i=1,5
+          //   21 y(i)=xtry(i)*1.d-10
+          for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      DEL=(TWO*y(2)*y(3))**2+FOUR*Y(1)*(Y(4)*(-Y(1)**2-Y(1)*Y(4)-
+          //     $Y(3)**2+Y(2)**2)+Y(2)**2*Y(1))
+          DEL = pow(TWO * y[2] * y[3], 2.0)
+              + FOUR * y[1]
+                  * (y[4]
+                      * (-pow(y[1], 2.0) - y[1] * y[4] - pow(y[3], 2.0)
+                          + pow(y[2], 2.0)) + pow(y[2], 2.0) * y[1]);
+
+          //      IF(DEL.LT.ZERO) GO TO 3
+          if (DEL < ZERO) continue;
+
+          //      DEL=DSQRT(DEL)
+          //      Y(5)=(TWO*Y(2)*Y(3)+DEL)/TWO/Y(1)
+          //      XTRY(5)=Y(5)*1.D+10
+          //      call f2(xtry,try)
+          DEL = sqrt(DEL);
+          y[5] = (TWO * y[2] * y[3] + DEL) / TWO / y[1];
+          xtry[5] = y[5] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      IF(TRY.GT.VAL) GO TO 22
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          if (tryy > val) goto p22;
+          RENUM(tryy, val, ix, j1, j2, j3, j4);
+
+          //      DO 12 i=1,5
+          //   12 x(i)=SNGL(XTRY(I))
+          for (int i = 1; i <= 5; i++)
+            x[i] = double(xtry[i]);
+
+          //   22 Y(5)=(TWO*Y(2)*Y(3)-DEL)/TWO/Y(1)
+          //      XTRY(5)=Y(5)*1.D+10
+          //      call f2(xtry,try)
+          p22: y[5] = (TWO * y[2] * y[3] - DEL) / TWO / y[1];
+          xtry[5] = y[5] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      IF(TRY.GT.VAL) GO TO 3
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          if (tryy > val) continue;
+          RENUM(tryy, val, ix, j1, j2, j3, j4);
+
+          //      DO 25 i=1,5
+          //   25 x(i)=SNGL(xtry(i))
+          for (int i = 1; i <= 5; i++)
+            x[i] = double(xtry[i]);
+          //      go to 3
+          continue;
+
+          //   23 if((DABS(XTRY(2)).lt.1.d-6).OR.(DABS(XTRY(3)).LT.1.d-6)) GO TO 3
+          p23: if (fabs(xtry[2]) < 1.0e-6 || fabs(xtry[3]) < 1.0e-6) continue;
+
+          //      DO 27 i=1,5
+          //   27 y(i)=xtry(i)*1.d-10
+          for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      DEL=Y(4)*(-Y(1)**2-Y(1)*Y(4)-Y(3)**2+Y(2)**2)+Y(2)**2*Y(1)
+
+          DEL = y[4]
+              * (-pow(y[1], 2.0) - y[1] * y[4] - pow(y[3], 2.0)
+                  + pow(y[2], 2.0)) + pow(y[2], 2.0) * y[1];
+
+          //      Y(5)=-DEL/TWO/Y(3)/Y(2)
+          //      XTRY(5)=Y(5)*1.d+10
+          //      call f2(xtry,try)
+          y[5] = -DEL / TWO / y[3] / y[2];
+          xtry[5] = y[5] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      if(try.gt.val) go to 3
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      do 28 i=1,5
+          //   28 x(i)=SNGL(xtry(i))
+          if (tryy > val) continue;
+          RENUM(tryy, val, ix, j1, j2, j3, j4);
+          for (int i = 1; i <= 5; i++)
+            x[i] = double(xtry[i]);
+        }
+      }
+      break;
+    case 2:
+      //C     Search for X1,X2,X3,X5; X4 is calculated:
+      //      do 103 j1=1,7
       //      xtry(1)=xlo(1)+DBLE(j1-1)*xstep(1)
       xtry[1] = xlo[1] + double(j1 - 1) * xstep[1];
       //      do 103 j2=1,7
-      for (int j2 = 1; j2 <= 7; j2++) {
-        //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
-        xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
-        //      do 103 j3=1,7
-        for (int j3 = 1; j3 <= 7; j3++) {
-          //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
-          xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
-          //      do 103 j4=1,7
-          for (int j4 = 1; j4 <= 7; j4++) {
-            //      xtry(5)=xlo(4)+DBLE(j4-1)*xstep(4)  
-            //      if(dabs(xtry(1)).lt.1.d-6) go to 123
-            xtry[5] = xlo[4] + double(j4 - 1) * xstep[4];
-            if (fabs(xtry[1]) < 1.0e-06) goto p123;
-
-            //      do 121 i=1,5
-            //  121 y(i)=xtry(i)*1.d-10
+      //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
+      xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
+      //      do 103 j3=1,7
+      for (int j3 = 1; j3 <= 7; j3++) {
+        //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
+        xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
+        //      do 103 j4=1,7
+        for (int j4 = 1; j4 <= 7; j4++) {
+          //      xtry(5)=xlo(4)+DBLE(j4-1)*xstep(4)  
+          //      if(dabs(xtry(1)).lt.1.d-6) go to 123
+          xtry[5] = xlo[4] + double(j4 - 1) * xstep[4];
+          if (fabs(xtry[1]) < 1.0e-06) goto p123;
+
+          //      do 121 i=1,5
+          //  121 y(i)=xtry(i)*1.d-10
+          for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      DEL=(-y(1)**2-y(3)**2+y(2)**2)**2+FOUR*Y(1)*(TWO*Y(2)*Y(3)*
+          //     $Y(5)-Y(1)*Y(5)**2+Y(1)*Y(2)**2)
+          DEL = pow(-pow(y[1], 2.0) - pow(y[3], 2.0) + pow(y[2], 2.0), 2.0)
+              + FOUR * y[1]
+                  * (TWO * y[2] * y[3] * y[5] - y[1] * pow(y[5], 2.0)
+                      + y[1] * pow(y[2], 2.0));
+
+          //      IF(DEL.LT.ZERO) GO TO 103
+          if (DEL < ZERO) continue;
+
+          //      DEL=DSQRT(DEL)
+          //      Y(4)=(-Y(1)**2-Y(3)**2+Y(2)**2+DEL)/TWO/Y(1)
+          //      XTRY(4)=Y(4)*1.D+10
+          //      call f2(xtry,try)
+          DEL = sqrt(DEL);
+          y[4] = (-pow(y[1], 2.0) - pow(y[3], 2.0) + pow(y[2], 2.0) + DEL)
+              / TWO / y[1];
+          xtry[4] = y[4] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      IF(TRY.GT.VAL) GO TO 122
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      DO 112 i=1,5
+          //  112 x(i)=SNGL(XTRY(I))
+          if (tryy <= val) {
+            RENUM(tryy, val, ix, j1, j2, j3, j4);
             for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      DEL=(-y(1)**2-y(3)**2+y(2)**2)**2+FOUR*Y(1)*(TWO*Y(2)*Y(3)*
-            //     $Y(5)-Y(1)*Y(5)**2+Y(1)*Y(2)**2)
-            DEL = pow(-pow(y[1], 2.0) - pow(y[3], 2.0) + pow(y[2], 2.0), 2.0)
-                + FOUR * y[1]
-                    * (TWO * y[2] * y[3] * y[5] - y[1] * pow(y[5], 2.0)
-                        + y[1] * pow(y[2], 2.0));
-
-            //      IF(DEL.LT.ZERO) GO TO 103
-            if (DEL < ZERO) continue;
-
-            //      DEL=DSQRT(DEL)
-            //      Y(4)=(-Y(1)**2-Y(3)**2+Y(2)**2+DEL)/TWO/Y(1)
-            //      XTRY(4)=Y(4)*1.D+10
-            //      call f2(xtry,try)
-            DEL = sqrt(DEL);
-            y[4] = (-pow(y[1], 2.0) - pow(y[3], 2.0) + pow(y[2], 2.0) + DEL)
-                / TWO / y[1];
-            xtry[4] = y[4] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      IF(TRY.GT.VAL) GO TO 122
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      DO 112 i=1,5
-            //  112 x(i)=SNGL(XTRY(I))
-            if (tryy <= val) {
-              RENUM(tryy, val, ix, j1, j2, j3, j4);
-              for (int i = 1; i <= 5; i++)
-                x[i] = xtry[i];
-            }
-
-            //  122 Y(4)=(-Y(1)**2-Y(3)**2+Y(2)**2-DEL)/TWO/Y(1)
-            y[4] = (-pow(y[1], 2.0) - pow(y[3], 2.0) + pow(y[2], 2.0) - DEL)
-                / TWO / y[1];
+              x[i] = xtry[i];
+          }
 
-            //      XTRY(4)=Y(4)*1.D+10
-            //      call f2(xtry,try)
-            //      IF(TRY.GT.VAL) GO TO 103
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            xtry[4] = y[4] * 1.0e+10;
-            f2(xtry, tryy);
-            if (tryy > val) continue;
+          //  122 Y(4)=(-Y(1)**2-Y(3)**2+Y(2)**2-DEL)/TWO/Y(1)
+          y[4] = (-pow(y[1], 2.0) - pow(y[3], 2.0) + pow(y[2], 2.0) - DEL)
+              / TWO / y[1];
+
+          //      XTRY(4)=Y(4)*1.D+10
+          //      call f2(xtry,try)
+          //      IF(TRY.GT.VAL) GO TO 103
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          xtry[4] = y[4] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+          if (tryy > val) continue;
+          RENUM(tryy, val, ix, j1, j2, j3, j4);
+
+          //      DO 125 i=1,5
+          //  125 x(i)=SNGL(xtry(i))
+          //      go to 103
+          for (int i = 1; i <= 5; i++)
+            x[i] = xtry[i];
+
+          continue;
+
+          //  123 DO 127 i=1,5
+          //  127 y(i)=xtry(i)*1.d-10
+          p123: for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      HELP=-y(1)**2-y(3)**2+y(2)**2
+          //      IF(DABS(HELP).LT.1.d-20) GO TO 103
+          //      DEL=TWO*y(2)*y(3)*y(5)-y(5)**2*y(1)+y(2)**2*y(1)
+          help = -pow(y[1], 2.0) - pow(y[3], 2.0) + pow(y[2], 2.0);
+          if (fabs(help) < 1.0e-20) continue;
+          DEL = TWO * y[2] * y[3] * y[5] - y[5] * y[5] * y[1]
+              + y[2] * y[2] * y[1];
+
+          //      Y(4)=-DEL/HELP
+          //      XTRY(4)=Y(4)*1.d+10
+          //      call f2(xtry,try)
+          y[4] = -DEL / help;
+          xtry[4] = y[4] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      if(try.gt.val) go to 103
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      do 128 i=1,5
+          //  128 x(i)=SNGL(xtry(i))
+          if (tryy <= val) {
             RENUM(tryy, val, ix, j1, j2, j3, j4);
-
-            //      DO 125 i=1,5
-            //  125 x(i)=SNGL(xtry(i))
-            //      go to 103
             for (int i = 1; i <= 5; i++)
               x[i] = xtry[i];
-
-            continue;
-
-            //  123 DO 127 i=1,5
-            //  127 y(i)=xtry(i)*1.d-10
-            p123: for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      HELP=-y(1)**2-y(3)**2+y(2)**2
-            //      IF(DABS(HELP).LT.1.d-20) GO TO 103
-            //      DEL=TWO*y(2)*y(3)*y(5)-y(5)**2*y(1)+y(2)**2*y(1)
-            help = -pow(y[1], 2.0) - pow(y[3], 2.0) + pow(y[2], 2.0);
-            if (fabs(help) < 1.0e-20) continue;
-            DEL = TWO * y[2] * y[3] * y[5] - y[5] * y[5] * y[1]
-                + y[2] * y[2] * y[1];
-
-            //      Y(4)=-DEL/HELP
-            //      XTRY(4)=Y(4)*1.d+10
-            //      call f2(xtry,try)
-            y[4] = -DEL / help;
-            xtry[4] = y[4] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      if(try.gt.val) go to 103
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      do 128 i=1,5
-            //  128 x(i)=SNGL(xtry(i))
-            if (tryy <= val) {
-              RENUM(tryy, val, ix, j1, j2, j3, j4);
-              for (int i = 1; i <= 5; i++)
-                x[i] = xtry[i];
-            }
           }
         }
       }
-    }
-    //  103 continue
-    //      if(val.eq.1.d+30) go to 130
-    //      DO 104 I=1,4
-    //      xhi(i)=xlo(i)+DBLE(ix(i)+1)*xstep(i)
-    //  104 xlo(i)=xlo(i)+DBLE(ix(i)-3)*xstep(i)
-    if (val == 1.0e+30) goto p130;
-    for (int i = 1; i <= 4; i++) {
-      xhi[i] = xlo[i] + double(ix[i] + 1) * xstep[i];
-      xlo[i] = xlo[i] + double(ix[i] - 3) * xstep[i];
-    }
-  }
-  //  108 CONTINUE
-  //      DO 129 I=1,5
-  //  129 XMEM(2,I)=X(I)
-  //      VMEM(2)=SNGL(VAL)
-  for (int i = 1; i <= 5; i++)
-    xmem[2][i] = x[i];
-  vmem[2] = val;
-
-  //C     Search for X1,X2,X4,X5; X3 is calculated:
-  //  130 val=1.d+30
-  p130: val = 1.0e+30;
-
-  //      do 201 i=1,4
-  //      xlo(i)=DBLE(-1.*10.**IEXP)
-  //      xhi(i)=DBLE(10.**IEXP)
-  //  201 ix(i)=0
-  for (int i = 1; i <= 4; i++) {
-    xlo[i] = -1.0 * pow(10, IEXP);
-    xhi[i] = pow(10, IEXP);
-    ix[i] = 0;
-  }
-
-  //      DO 208 l=1,50
-  for (int l = 1; l <= 50; l++) {
-    PROGRESS(l + 200, 350);
-    //      do 202 i=1,4
-    //  202 xstep(i)=(xhi(i)-xlo(i))/SIX
-    for (int i = 1; i <= 4; i++)
-      xstep[i] = (xhi[i] - xlo[i]) / SIX;
-
-    //      size=xhi(1)-xlo(1)
-    //      iter=iter+1
-    //      xtry(3)=ZERO
-    //      CALL POSTEP(METH,JTER,J7)
-    //SIZE = xhi[1] - xlo[1];
-    iter++;
-    xtry[3] = 0.0;
-    //POSTEP(METH,jter,j7);
-
-    //      do 203 j1=1,7
-    for (int j1 = 1; j1 <= 7; j1++) {
+      break;
+    case 3:
+      //C     Search for X1,X2,X4,X5; X3 is calculated:
+      //      do 203 j1=1,7
       //      xtry(1)=xlo(1)+DBLE(j1-1)*xstep(1)
       xtry[1] = xlo[1] + double(j1 - 1) * xstep[1];
       //      do 203 j2=1,7
-      for (int j2 = 1; j2 <= 7; j2++) {
-        //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
-        xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
-        //      do 203 j3=1,7
-        for (int j3 = 1; j3 <= 7; j3++) {
-          //      xtry(4)=xlo(3)+DBLE(j3-1)*xstep(3)
-          xtry[4] = xlo[3] + double(j3 - 1) * xstep[3];
-          //      do 203 j4=1,7
-          for (int j4 = 1; j4 <= 7; j4++) {
-            //      xtry(5)=xlo(4)+DBLE(j4-1)*xstep(4)
-            xtry[5] = xlo[4] + double(j4 - 1) * xstep[4];
-
-            //      if(abs(xtry(4)).lt.1.d-6) go to 223
-            if (fabs(xtry[4]) < 1.0e-06) goto p223;
-
-            //      do 221 i=1,5
-            //  221 y(i)=xtry(i)*1.d-10
-            for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      DEL=(TWO*Y(2)*Y(5))**2+FOUR*Y(4)*(-y(1)**2*y(4)-Y(1)*Y(4)**2-
-            //     $Y(5)**2*Y(1)+Y(2)**2*Y(1)+Y(2)**2*Y(4))
-            DEL = pow(TWO * y[2] * y[5], 2.0)
-                + FOUR * y[4]
-                    * (-y[1] * y[1] * y[4] - y[1] * y[4] * y[4]
-                        - y[5] * y[5] * y[1] + y[2] * y[2] * y[1]
-                        + y[2] * y[2] * y[4]);
-
-            //      IF(DEL.LT.ZERO) GO TO 203
-            if (DEL < ZERO) continue;
-
-            //      DEL=dSQRT(DEL)
-            //      Y(3)=(TWO*Y(2)*Y(5)+DEL)/TWO/Y(4)
-            //      XTRY(3)=Y(3)*1.D+10
-            //      call f2(xtry,try)
-            DEL = sqrt(DEL);
-            y[3] = (TWO * y[2] * y[5] + DEL) / TWO / y[4];
-            xtry[3] = y[3] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      IF(TRY.GT.VAL) GO TO 222
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      DO 212 i=1,5
-            //  212 x(i)=SNGL(XTRY(I))
-            if (tryy <= val) {
-              RENUM(tryy, val, ix, j1, j2, j3, j4);
-              for (int i = 1; i <= 5; i++)
-                x[i] = xtry[i];
-            }
-
-            //  222 Y(3)=(TWO*Y(2)*Y(5)-DEL)/TWO/Y(4)
-            y[3] = (TWO * y[2] * y[5] - DEL) / TWO / y[4];
-
-            //      XTRY(3)=Y(3)*1.d+10
-            //      call f2(xtry,try)
-            //      IF(TRY.GT.VAL) GO TO 203
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            xtry[3] = y[3] * 1.0e+10;
-            f2(xtry, tryy);
-            if (tryy > val) continue;
+      //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
+      xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
+      //      do 203 j3=1,7
+      for (int j3 = 1; j3 <= 7; j3++) {
+        //      xtry(4)=xlo(3)+DBLE(j3-1)*xstep(3)
+        xtry[4] = xlo[3] + double(j3 - 1) * xstep[3];
+        //      do 203 j4=1,7
+        for (int j4 = 1; j4 <= 7; j4++) {
+          //      xtry(5)=xlo(4)+DBLE(j4-1)*xstep(4)
+          xtry[5] = xlo[4] + double(j4 - 1) * xstep[4];
+
+          //      if(abs(xtry(4)).lt.1.d-6) go to 223
+          if (fabs(xtry[4]) < 1.0e-06) goto p223;
+
+          //      do 221 i=1,5
+          //  221 y(i)=xtry(i)*1.d-10
+          for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      DEL=(TWO*Y(2)*Y(5))**2+FOUR*Y(4)*(-y(1)**2*y(4)-Y(1)*Y(4)**2-
+          //     $Y(5)**2*Y(1)+Y(2)**2*Y(1)+Y(2)**2*Y(4))
+          DEL = pow(TWO * y[2] * y[5], 2.0)
+              + FOUR * y[4]
+                  * (-y[1] * y[1] * y[4] - y[1] * y[4] * y[4]
+                      - y[5] * y[5] * y[1] + y[2] * y[2] * y[1]
+                      + y[2] * y[2] * y[4]);
+
+          //      IF(DEL.LT.ZERO) GO TO 203
+          if (DEL < ZERO) continue;
+
+          //      DEL=dSQRT(DEL)
+          //      Y(3)=(TWO*Y(2)*Y(5)+DEL)/TWO/Y(4)
+          //      XTRY(3)=Y(3)*1.D+10
+          //      call f2(xtry,try)
+          DEL = sqrt(DEL);
+          y[3] = (TWO * y[2] * y[5] + DEL) / TWO / y[4];
+          xtry[3] = y[3] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      IF(TRY.GT.VAL) GO TO 222
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      DO 212 i=1,5
+          //  212 x(i)=SNGL(XTRY(I))
+          if (tryy <= val) {
             RENUM(tryy, val, ix, j1, j2, j3, j4);
-
-            //      DO 225 i=1,5
-            //  225 x(i)=sngl(xtry(i))
-            //      go to 203
             for (int i = 1; i <= 5; i++)
               x[i] = xtry[i];
-            continue;
+          }
 
-            //  223 IF((dABS(XTRY(2)).LT.1.d-6).OR.(dABS(XTRY(5)).LT.1.d-6))
-            //     $ GO TO 203
-            p223: if (fabs(xtry[2]) < 1.0e-6 || fabs(xtry[5]) < 1.0e-06)
-              continue;
+          //  222 Y(3)=(TWO*Y(2)*Y(5)-DEL)/TWO/Y(4)
+          y[3] = (TWO * y[2] * y[5] - DEL) / TWO / y[4];
+
+          //      XTRY(3)=Y(3)*1.d+10
+          //      call f2(xtry,try)
+          //      IF(TRY.GT.VAL) GO TO 203
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          xtry[3] = y[3] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+          if (tryy > val) continue;
+          RENUM(tryy, val, ix, j1, j2, j3, j4);
+
+          //      DO 225 i=1,5
+          //  225 x(i)=sngl(xtry(i))
+          //      go to 203
+          for (int i = 1; i <= 5; i++)
+            x[i] = xtry[i];
+          continue;
+
+          //  223 IF((dABS(XTRY(2)).LT.1.d-6).OR.(dABS(XTRY(5)).LT.1.d-6))
+          //     $ GO TO 203
+          p223: if (fabs(xtry[2]) < 1.0e-6 || fabs(xtry[5]) < 1.0e-06)
+            continue;
 
-            //      DO 227 i=1,5
-            //  227 y(i)=xtry(i)*1.d-10
+          //      DO 227 i=1,5
+          //  227 y(i)=xtry(i)*1.d-10
+          for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      DEL=-y(1)**2*y(4)-Y(1)*y(4)**2-Y(5)**2*Y(1)+Y(2)**2*(Y(1)+Y(4))
+          DEL = -y[1] * y[1] * y[4] - y[1] * y[4] * y[4] - y[5] * y[5] * y[1]
+              + y[2] * y[2] * (y[1] + y[4]);
+
+          //      Y(3)=-DEL/TWO/Y(2)/Y(5)
+          //      XTRY(3)=Y(3)*1.d+10
+          //      call f2(xtry,try)
+          y[3] = -DEL / TWO / y[2] / y[5];
+          xtry[3] = y[3] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      if(try.gt.val) go to 203
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      do 228 i=1,5
+          //  228 x(i)=SNGL(xtry(i))
+          if (tryy <= val) {
+            RENUM(tryy, val, ix, j1, j2, j3, j4);
             for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      DEL=-y(1)**2*y(4)-Y(1)*y(4)**2-Y(5)**2*Y(1)+Y(2)**2*(Y(1)+Y(4))
-            DEL = -y[1] * y[1] * y[4] - y[1] * y[4] * y[4] - y[5] * y[5] * y[1]
-                + y[2] * y[2] * (y[1] + y[4]);
-
-            //      Y(3)=-DEL/TWO/Y(2)/Y(5)
-            //      XTRY(3)=Y(3)*1.d+10
-            //      call f2(xtry,try)
-            y[3] = -DEL / TWO / y[2] / y[5];
-            xtry[3] = y[3] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      if(try.gt.val) go to 203
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      do 228 i=1,5
-            //  228 x(i)=SNGL(xtry(i))
-            if (tryy <= val) {
-              RENUM(tryy, val, ix, j1, j2, j3, j4);
-              for (int i = 1; i <= 5; i++)
-                x[i] = double(xtry[i]);
-            }
+              x[i] = double(xtry[i]);
           }
         }
       }
-    }
-    //  203 continue
-    //      if(val.eq.1.d+30) go to 230
-    //      DO 204 I=1,4
-    //      xhi(i)=xlo(i)+DBLE(ix(i)+1)*xstep(i)
-    //  204 xlo(i)=xlo(i)+DBLE(ix(i)-3)*xstep(i)
-    if (val == 1.0e+30) goto p230;
-    for (int i = 1; i <= 4; i++) {
-      xhi[i] = xlo[i] + double(ix[i] + 1) * xstep[i];
-      xlo[i] = xlo[i] + double(ix[i] - 3) * xstep[i];
-    }
-  }
-  //  208 CONTINUE
-
-  //      DO 229 I=1,5
-  //  229 XMEM(3,I)=X(I)
-  //      VMEM(3)=SNGL(VAL)
-  for (int i = 1; i <= 5; i++)
-    xmem[3][i] = x[i];
-  vmem[3] = val;
-
-  //C     Search for X1,X3,X4,X5; X2 is calculated:
-  //  230 val=1.d+30
-  //      do 301 i=1,4
-  //      xlo(i)=DBLE(-1.*10.**IEXP)
-  //      xhi(i)=DBLE(10.**IEXP)
-  //  301 ix(i)=0
-  p230: val = 1.0e+30;
-  for (int i = 1; i <= 4; i++) {
-    xlo[i] = -1.0 * pow(10, IEXP);
-    xhi[i] = pow(10, IEXP);
-    ix[i] = 0;
-  }
-
-  //      DO 308 l=1,50
-  for (int l = 1; l <= 50; l++) {
-    PROGRESS(l + 250, 350);
-    //      do 302 i=1,4
-    //  302 xstep(i)=(xhi(i)-xlo(i))/SIX
-    for (int i = 1; i <= 4; i++)
-      xstep[i] = (xhi[i] - xlo[i]) / SIX;
-
-    //      size=xhi(1)-xlo(1)
-    //      iter=iter+1
-    //      xtry(2)=ZERO
-    //      CALL POSTEP(METH,JTER,J7)
-    //SIZE = xhi[1] - xlo[1];
-    iter++;
-    xtry[2] = 0.0;
-    //POSTEP(METH,jter,j7);
-
-    //      do 303 j1=1,7
-    for (int j1 = 1; j1 <= 7; j1++) {
+      break;
+    case 4:
+      //C     Search for X1,X3,X4,X5; X2 is calculated:
+      //      do 303 j1=1,7
       //      xtry(1)=xlo(1)+DBLE(j1-1)*xstep(1)
       xtry[1] = xlo[1] + double(j1 - 1) * xstep[1];
       //      do 103 j2=1,7
-      for (int j2 = 1; j2 <= 7; j2++) {
-        //      xtry(3)=xlo(2)+DBLE(j2-1)*xstep(2)
-        xtry[3] = xlo[2] + double(j2 - 1) * xstep[2];
-        //      do 303 j3=1,7
-        for (int j3 = 1; j3 <= 7; j3++) {
-          //      xtry(4)=xlo(3)+DBLE(j3-1)*xstep(3)
-          xtry[4] = xlo[3] + double(j3 - 1) * xstep[3];
-          //      do 303 j4=1,7
-          for (int j4 = 1; j4 <= 7; j4++) {
-            //      xtry(5)=xlo(4)+DBLE(j4-1)*xstep(4)
-            xtry[5] = xlo[4] + double(j4 - 1) * xstep[4];
-            //      if(dabs(xtry(4)+XTRY(1)).lt.1.d-6) go to 323
-            if (fabs(xtry[4] + xtry[1]) < 1.0e-06) goto p323;
-
-            //      do 321 i=1,5
-            //  321 y(i)=xtry(i)*1.d-10
-            for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      DEL=(TWO*Y(3)*Y(5))**2-FOUR*(Y(1)+Y(4))*(-y(1)**2*y(4)-Y(1)*
-            //     $Y(4)**2-Y(5)**2*Y(1)-y(3)**2*Y(4))
-            DEL = pow(TWO * y[3] * y[5], 2.0)
-                - FOUR * (y[1] + y[4])
-                    * (-y[1] * y[1] * y[4] - y[1] * y[4] * y[4]
-                        - y[5] * y[5] * y[1] - y[3] * y[3] * y[4]);
-
-            //      IF(DEL.LT.ZERO) GO TO 303
-            if (DEL < ZERO) continue;
-
-            //      DEL=DSQRT(DEL)
-            //      Y(2)=(-TWO*Y(3)*Y(5)-DEL)/TWO/(Y(1)+Y(4))
-            //      XTRY(2)=Y(2)*1.D+10
-            //      call f2(xtry,try)
-            DEL = sqrt(DEL);
-            y[2] = (-TWO * y[3] * y[5] - DEL) / TWO / (y[1] + y[4]);
-            xtry[2] = y[2] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      IF(TRY.GT.VAL) GO TO 322
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      DO 312 i=1,5
-            //  312 x(i)=SNGL(XTRY(I))
-            if (tryy <= val) /* ONE : poprawiony bd 2006.10.05 */
-            {
-              RENUM(tryy, val, ix, j1, j2, j3, j4);
-              for (int i = 1; i <= 5; i++)
-                x[i] = xtry[i];
-            }
-
-            //  322 Y(2)=(-TWO*Y(3)*Y(5)+DEL)/TWO/(Y(1)+Y(4))
-            //      XTRY(2)=Y(2)*1.D+10
-            //      call f2(xtry,try)
-            y[2] = (-TWO * y[3] * y[5] + DEL) / TWO / (y[1] + y[4]);
-            xtry[2] = y[2] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      IF(TRY.GT.VAL) GO TO 303
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            if (tryy > val) continue;
+      //      xtry(3)=xlo(2)+DBLE(j2-1)*xstep(2)
+      xtry[3] = xlo[2] + double(j2 - 1) * xstep[2];
+      //      do 303 j3=1,7
+      for (int j3 = 1; j3 <= 7; j3++) {
+        //      xtry(4)=xlo(3)+DBLE(j3-1)*xstep(3)
+        xtry[4] = xlo[3] + double(j3 - 1) * xstep[3];
+        //      do 303 j4=1,7
+        for (int j4 = 1; j4 <= 7; j4++) {
+          //      xtry(5)=xlo(4)+DBLE(j4-1)*xstep(4)
+          xtry[5] = xlo[4] + double(j4 - 1) * xstep[4];
+          //      if(dabs(xtry(4)+XTRY(1)).lt.1.d-6) go to 323
+          if (fabs(xtry[4] + xtry[1]) < 1.0e-06) goto p323;
+
+          //      do 321 i=1,5
+          //  321 y(i)=xtry(i)*1.d-10
+          for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      DEL=(TWO*Y(3)*Y(5))**2-FOUR*(Y(1)+Y(4))*(-y(1)**2*y(4)-Y(1)*
+          //     $Y(4)**2-Y(5)**2*Y(1)-y(3)**2*Y(4))
+          DEL = pow(TWO * y[3] * y[5], 2.0)
+              - FOUR * (y[1] + y[4])
+                  * (-y[1] * y[1] * y[4] - y[1] * y[4] * y[4]
+                      - y[5] * y[5] * y[1] - y[3] * y[3] * y[4]);
+
+          //      IF(DEL.LT.ZERO) GO TO 303
+          if (DEL < ZERO) continue;
+
+          //      DEL=DSQRT(DEL)
+          //      Y(2)=(-TWO*Y(3)*Y(5)-DEL)/TWO/(Y(1)+Y(4))
+          //      XTRY(2)=Y(2)*1.D+10
+          //      call f2(xtry,try)
+          DEL = sqrt(DEL);
+          y[2] = (-TWO * y[3] * y[5] - DEL) / TWO / (y[1] + y[4]);
+          xtry[2] = y[2] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      IF(TRY.GT.VAL) GO TO 322
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      DO 312 i=1,5
+          //  312 x(i)=SNGL(XTRY(I))
+          if (tryy <= val) /* ONE : poprawiony bd 2006.10.05 */
+          {
             RENUM(tryy, val, ix, j1, j2, j3, j4);
-
-            //      DO 325 i=1,5
-            //  325 x(i)=SNGL(xtry(i))
-            //      go to 303
             for (int i = 1; i <= 5; i++)
               x[i] = xtry[i];
-            continue;
+          }
 
-            //  323 IF((DABS(XTRY(3)).LT.1.d-6).OR.(DABS(XTRY(5)).LT.1.d-6))
-            //     $ GO TO 303
-            p323: if (fabs(xtry[3]) < 1.0e-06 || fabs(xtry[5]) < 1.0e-06)
-              continue;
+          //  322 Y(2)=(-TWO*Y(3)*Y(5)+DEL)/TWO/(Y(1)+Y(4))
+          //      XTRY(2)=Y(2)*1.D+10
+          //      call f2(xtry,try)
+          y[2] = (-TWO * y[3] * y[5] + DEL) / TWO / (y[1] + y[4]);
+          xtry[2] = y[2] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      IF(TRY.GT.VAL) GO TO 303
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          if (tryy > val) continue;
+          RENUM(tryy, val, ix, j1, j2, j3, j4);
+
+          //      DO 325 i=1,5
+          //  325 x(i)=SNGL(xtry(i))
+          //      go to 303
+          for (int i = 1; i <= 5; i++)
+            x[i] = xtry[i];
+          continue;
+
+          //  323 IF((DABS(XTRY(3)).LT.1.d-6).OR.(DABS(XTRY(5)).LT.1.d-6))
+          //     $ GO TO 303
+          p323: if (fabs(xtry[3]) < 1.0e-06 || fabs(xtry[5]) < 1.0e-06)
+            continue;
 
-            //      DO 327 i=1,5
-            //  327 y(i)=xtry(i)*1.d-10
+          //      DO 327 i=1,5
+          //  327 y(i)=xtry(i)*1.d-10
+          for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      DEL=-y(1)**2*y(4)-Y(1)*y(4)**2-Y(5)**2*Y(1)-Y(3)**2*Y(4)
+          DEL = -y[1] * y[1] * y[4] - y[1] * y[4] * y[4] - y[5] * y[5] * y[1]
+              - y[3] * y[3] * y[4];
+
+          //      Y(2)=-DEL/TWO/Y(3)/Y(5)
+          //      XTRY(2)=Y(2)*1.d+10
+          //      call f2(xtry,try)
+          y[2] = -DEL / TWO / y[3] / y[5];
+          xtry[2] = y[2] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      if(try.gt.val) go to 303
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      do 328 i=1,5
+          //  328 x(i)=SNGL(xtry(i))
+          if (tryy <= val) {
+            RENUM(tryy, val, ix, j1, j2, j3, j4);
             for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      DEL=-y(1)**2*y(4)-Y(1)*y(4)**2-Y(5)**2*Y(1)-Y(3)**2*Y(4)
-            DEL = -y[1] * y[1] * y[4] - y[1] * y[4] * y[4] - y[5] * y[5] * y[1]
-                - y[3] * y[3] * y[4];
-
-            //      Y(2)=-DEL/TWO/Y(3)/Y(5)
-            //      XTRY(2)=Y(2)*1.d+10
-            //      call f2(xtry,try)
-            y[2] = -DEL / TWO / y[3] / y[5];
-            xtry[2] = y[2] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      if(try.gt.val) go to 303
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      do 328 i=1,5
-            //  328 x(i)=SNGL(xtry(i))
-            if (tryy <= val) {
-              RENUM(tryy, val, ix, j1, j2, j3, j4);
-              for (int i = 1; i <= 5; i++)
-                x[i] = xtry[i];
-            }
+              x[i] = xtry[i];
           }
         }
       }
-    }
-    //  303 continue
-    //      if(val.eq.1.d+30) go to 330
-    //      DO 304 I=1,4
-    //      xhi(i)=xlo(i)+DBLE(ix(i)+1)*xstep(i)
-    //  304 xlo(i)=xlo(i)+DBLE(ix(i)-3)*xstep(i)
-    if (val == 1.0e+30) goto p330;
-    for (int i = 1; i <= 4; i++) {
-      xhi[i] = xlo[i] + double(ix[i] + 1) * xstep[i];
-      xlo[i] = xlo[i] + double(ix[i] - 3) * xstep[i];
-    }
-  }
-  //  308 CONTINUE
-  //      DO 329 I=1,5
-  //  329 XMEM(4,I)=X(I)
-  //      VMEM(4)=SNGL(VAL)
-  for (int i = 1; i <= 5; i++)
-    xmem[4][i] = x[i];
-  vmem[4] = val;
-
-  //C     Search for X2,X2,X3,X5; X1 is calculated:
-  //  330 val=1.d+30
-  p330: val = 1.0e+30;
-  //      do 401 i=1,4
-  //      xlo(i)=DBLE(-1.*10.**IEXP)
-  //      xhi(i)=DBLE(10.**IEXP)
-  //  401 ix(i)=0
-  for (int i = 1; i <= 4; i++) {
-    xlo[i] = -1.0 * pow(10, IEXP);
-    xhi[i] = pow(10, IEXP);
-    ix[i] = 0;
-  }
-
-  //      DO 408 l=1,50
-  for (int l = 1; l <= 50; l++) {
-    PROGRESS(l + 300, 350);
-    //      do 402 i=1,4
-    //  402 xstep(i)=(xhi(i)-xlo(i))/SIX
-    for (int i = 1; i <= 4; i++)
-      xstep[i] = (xhi[i] - xlo[i]) / SIX;
-
-    //      size=xhi(1)-xlo(1)
-    //      iter=iter+1
-    //      xtry(1)=ZERO
-    //      CALL POSTEP(METH,JTER,J7)
-    //SIZE = xhi[1] - xlo[1];
-    iter++;
-    xtry[1] = 0.0; /* ONE : poprawiony bd 2006.10.05 */
-    //POSTEP(METH,jter,j7);
-
-    //      do 403 j1=1,7
-    for (int j1 = 1; j1 <= 7; j1++) {
+      break;
+    case 5:
+      //C     Search for X2,X2,X3,X5; X1 is calculated:
+      //      do 403 j1=1,7
       //      xtry(2)=xlo(1)+DBLE(j1-1)*xstep(1)
       xtry[2] = xlo[1] + double(j1 - 1) * xstep[1];
       //      do 403 j2=1,7
-      for (int j2 = 1; j2 <= 7; j2++) {
-        //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
-        xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
-        //      do 403 j3=1,7
-        for (int j3 = 1; j3 <= 7; j3++) {
-          //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
-          xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
-          //      do 403 j4=1,7
-          for (int j4 = 1; j4 <= 7; j4++) {
-            //      xtry(5)=xlo(4)+DBLE(j4-1)*xstep(4)
-            xtry[5] = xlo[4] + double(j4 - 1) * xstep[4];
-
-            //      if(dabs(xtry(4)).lt.1.d-6) go to 423
-            if (fabs(xtry[4]) < 1.0e-06) goto p423;
-
-            //      do 421 i=1,5
-            //  421 y(i)=xtry(i)*1.d-10
+      //      xtry(2)=xlo(2)+DBLE(j2-1)*xstep(2)
+      xtry[2] = xlo[2] + double(j2 - 1) * xstep[2];
+      //      do 403 j3=1,7
+      for (int j3 = 1; j3 <= 7; j3++) {
+        //      xtry(3)=xlo(3)+DBLE(j3-1)*xstep(3)
+        xtry[3] = xlo[3] + double(j3 - 1) * xstep[3];
+        //      do 403 j4=1,7
+        for (int j4 = 1; j4 <= 7; j4++) {
+          //      xtry(5)=xlo(4)+DBLE(j4-1)*xstep(4)
+          xtry[5] = xlo[4] + double(j4 - 1) * xstep[4];
+
+          //      if(dabs(xtry(4)).lt.1.d-6) go to 423
+          if (fabs(xtry[4]) < 1.0e-06) goto p423;
+
+          //      do 421 i=1,5
+          //  421 y(i)=xtry(i)*1.d-10
+          for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      DEL=(-y(4)**2-y(5)**2+y(2)**2)**2+FOUR*Y(4)*(TWO*Y(2)*Y(3)*Y(5)
+          //     $-Y(4)*Y(3)**2+Y(4)*Y(2)**2)
+          DEL = pow(-y[4] * y[4] - y[5] * y[5] + y[2] * y[2], 2.0)
+              + FOUR * y[4]
+                  * (TWO * y[2] * y[3] * y[5] - y[4] * y[3] * y[3]
+                      + y[4] * y[2] * y[2]);
+
+          //      IF(DEL.LT.ZERO) GO TO 403
+          if (DEL < ZERO) continue;
+
+          //      DEL=DSQRT(DEL)
+          //      Y(1)=(-Y(4)**2-Y(5)**2+Y(2)**2+DEL)/TWO/Y(4)
+          //      XTRY(1)=Y(1)*1.D+10
+          //      call f2(xtry,try)
+          DEL = sqrt(DEL);
+          y[1] = (-y[4] * y[4] - y[5] * y[5] + y[2] * y[2] + DEL) / TWO
+              / y[4];
+          xtry[1] = y[1] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+
+          //      IF(TRY.GT.VAL) GO TO 422
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      DO 412 i=1,5
+          //  412 x(i)=SNGL(XTRY(I))
+          if (tryy <= val) {
+            RENUM(tryy, val, ix, j1, j2, j3, j4);
             for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      DEL=(-y(4)**2-y(5)**2+y(2)**2)**2+FOUR*Y(4)*(TWO*Y(2)*Y(3)*Y(5)
-            //     $-Y(4)*Y(3)**2+Y(4)*Y(2)**2)
-            DEL = pow(-y[4] * y[4] - y[5] * y[5] + y[2] * y[2], 2.0)
-                + FOUR * y[4]
-                    * (TWO * y[2] * y[3] * y[5] - y[4] * y[3] * y[3]
-                        + y[4] * y[2] * y[2]);
-
-            //      IF(DEL.LT.ZERO) GO TO 403
-            if (DEL < ZERO) continue;
-
-            //      DEL=DSQRT(DEL)
-            //      Y(1)=(-Y(4)**2-Y(5)**2+Y(2)**2+DEL)/TWO/Y(4)
-            //      XTRY(1)=Y(1)*1.D+10
-            //      call f2(xtry,try)
-            DEL = sqrt(DEL);
-            y[1] = (-y[4] * y[4] - y[5] * y[5] + y[2] * y[2] + DEL) / TWO
-                / y[4];
-            xtry[1] = y[1] * 1.0e+10;
-            f2(xtry, tryy);
-
-            //      IF(TRY.GT.VAL) GO TO 422
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      DO 412 i=1,5
-            //  412 x(i)=SNGL(XTRY(I))
-            if (tryy <= val) {
-              RENUM(tryy, val, ix, j1, j2, j3, j4);
-              for (int i = 1; i <= 5; i++)
-                x[i] = xtry[i];
-            }
-
-            //  422 Y(1)=(-Y(4)**2-Y(5)**2+Y(2)**2-DEL)/TWO/Y(4)
-            y[1] = (-y[4] * y[4] - y[5] * y[5] + y[2] * y[2] - DEL) / TWO
-                / y[4];
+              x[i] = xtry[i];
+          }
 
-            //      XTRY(1)=Y(1)*1.D+10
-            //      call f2(xtry,try)
-            //      IF(TRY.GT.VAL) GO TO 403
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            xtry[1] = y[1] * 1.0e+10;
-            f2(xtry, tryy);
-            if (tryy > val) continue;
+          //  422 Y(1)=(-Y(4)**2-Y(5)**2+Y(2)**2-DEL)/TWO/Y(4)
+          y[1] = (-y[4] * y[4] - y[5] * y[5] + y[2] * y[2] - DEL) / TWO
+              / y[4];
+
+          //      XTRY(1)=Y(1)*1.D+10
+          //      call f2(xtry,try)
+          //      IF(TRY.GT.VAL) GO TO 403
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          xtry[1] = y[1] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+          if (tryy > val) continue;
+          RENUM(tryy, val, ix, j1, j2, j3, j4);
+
+          //      DO 425 i=1,5
+          //  425 x(i)=SNGL(xtry(i))
+          //      go to 403
+          for (int i = 1; i <= 5; i++)
+            x[i] = xtry[i];
+          continue;
+          //  423 DO 427 i=1,5
+          //  427 y(i)=xtry(i)*1.d-10
+          p423: for (int i = 1; i <= 5; i++)
+            y[i] = xtry[i] * 1.0e-10;
+
+          //      HELP=-y(4)**2-y(5)**2+y(2)**2
+          //      IF(DABS(HELP).LT.1.d-20) GO TO 403
+          //      DEL=TWO*y(2)*y(3)*y(5)-y(3)**2*y(4)+y(2)**2*y(4)
+          help = -pow(y[4], 2.0) - pow(y[5], 2.0) + pow(y[2], 2.0);
+          if (fabs(help) < 1.0e-20) continue;
+          DEL = TWO * y[2] * y[3] * y[5] - y[3] * y[3] * y[4]
+              + y[2] * y[2] * y[4];
+
+          //      Y(1)=-DEL/HELP
+          //      XTRY(1)=Y(1)*1.d+10
+          //      call f2(xtry,try)
+          y[1] = -DEL / help;
+          xtry[1] = y[1] * 1.0e+10;
+          f2(xtry, tryy, val, VIS);
+          //      if(try.gt.val) go to 403
+          //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
+          //      do 428 i=1,5
+          //  428 x(i)=SNGL(xtry(i))
+          if (tryy <= val) {
             RENUM(tryy, val, ix, j1, j2, j3, j4);
-
-            //      DO 425 i=1,5
-            //  425 x(i)=SNGL(xtry(i))
-            //      go to 403
             for (int i = 1; i <= 5; i++)
               x[i] = xtry[i];
-            continue;
-            //  423 DO 427 i=1,5
-            //  427 y(i)=xtry(i)*1.d-10
-            p423: for (int i = 1; i <= 5; i++)
-              y[i] = xtry[i] * 1.0e-10;
-
-            //      HELP=-y(4)**2-y(5)**2+y(2)**2
-            //      IF(DABS(HELP).LT.1.d-20) GO TO 403
-            //      DEL=TWO*y(2)*y(3)*y(5)-y(3)**2*y(4)+y(2)**2*y(4)
-            help = -pow(y[4], 2.0) - pow(y[5], 2.0) + pow(y[2], 2.0);
-            if (fabs(help) < 1.0e-20) continue;
-            DEL = TWO * y[2] * y[3] * y[5] - y[3] * y[3] * y[4]
-                + y[2] * y[2] * y[4];
-
-            //      Y(1)=-DEL/HELP
-            //      XTRY(1)=Y(1)*1.d+10
-            //      call f2(xtry,try)
-            y[1] = -DEL / help;
-            xtry[1] = y[1] * 1.0e+10;
-            f2(xtry, tryy);
-            //      if(try.gt.val) go to 403
-            //      CALL RENUM(TRY,VAL,IX,J1,J2,J3,J4)
-            //      do 428 i=1,5
-            //  428 x(i)=SNGL(xtry(i))
-            if (tryy <= val) {
-              RENUM(tryy, val, ix, j1, j2, j3, j4);
-              for (int i = 1; i <= 5; i++)
-                x[i] = xtry[i];
-            }
           }
         }
       }
-    }
-
-    //  403 continue
-    //      if(val.eq.1.d+30) go to 430
-    //      DO 404 I=1,4
-    //      xhi(i)=xlo(i)+DBLE(ix(i)+1)*xstep(i)
-    //  404 xlo(i)=xlo(i)+DBLE(ix(i)-3)*xstep(i)
-    if (val == 1.0e+30) goto p430;
-    for (int i = 1; i <= 4; i++) {
-      xhi[i] = xlo[i] + double(ix[i] + 1) * xstep[i];
-      xlo[i] = xlo[i] + double(ix[i] - 3) * xstep[i];
-    }
-  }
-  //  408 CONTINUE
-  //      DO 429 I=1,5
-  //  429 XMEM(5,I)=X(I)
-  //      VMEM(5)=SNGL(VAL)
-  for (int i = 1; i <= 5; i++)
-    xmem[5][i] = x[i];
-  vmem[5] = val;
-
-  //  430 DO 31 I=1,4
-  p430: for (int i = 1; i <= 4; i++) {
-    //      IF(VMEM(I).GT.VMEM(5)) GO TO 31
-    //      VMEM(5)=VMEM(I)
-    //      DO 32 J=1,5
-    //   32 X(J)=XMEM(I,J)
-    if (vmem[i] > vmem[5]) break;
-    vmem[5] = vmem[i];
-    for (int j = 1; j <= 5; j++)
-      x[j] = xmem[i][j];
+      break;
   }
-  //   31 CONTINUE
-  //      return
-  //      END
 }
 //-----------------------------------------------------------------------------
 
@@ -4847,33 +6619,38 @@ void Taquart::UsmtCore::f2(double x[], double &ffg) {
   //      DOUBLE PRECISION SUM,X(5),FFG
 
   //      FFG=DBLE(0.)
-  ffg = 0.0;
-  double SUM = 0.0;
-
   //      DO 1 I=1,N
-  for (int i = 1; i <= N; i++) {
-    //      SUM=DBLE(0.)
-    SUM = 0.0;
-
-    //      DO 2 J=1,5
-    //    2 SUM=SUM+DBLE(A(I,J))*X(J)
-    for (int j = 1; j <= 5; j++)
-      SUM += (A[i][j] * x[j]);
-
-    //      SUM=SUM-DBLE(A(I,6))*(X(1)+X(4))
-    SUM -= (A[i][6] * (x[1] + x[4]));
-
-    //      FFG=FFG+DABS(SUM-DBLE(U(I)))
-    ffg += fabs(SUM - U[i]);
-
-  }
+  //      SUM=DBLE(0.)
+  //      DO 2 J=1,5
+  //    2 SUM=SUM+DBLE(A(I,J))*X(J)
+  //      SUM=SUM-DBLE(A(I,6))*(X(1)+X(4))
+  //      FFG=FFG+DABS(SUM-DBLE(U(I)))
   //    1 CONTINUE
+  ffg = L1SumF2(AT, x, U, N);
   //      IF(DABS(FFG).GT.1.D+30) FFG=1.D+30
   if (fabs(ffg) > 1.0e+30) ffg = 1.0e+30;
   //      RETURN
   //      END
 }
 
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::f2(double x[], double &ffg, double val,
+    double VIS[]) {
+  // F2 of a grid point compared with the best misfit VAL, see F1.
+  if (!L1Abandon || val >= 1e+30) {
+    f2(x, ffg);
+    return;
+  }
+  int k = 0;
+  const double LIMIT = val + val * 1e-12;
+  ffg = L1SumF2Abandon(AT, x, U, L1ORDER, N, LIMIT, k);
+  VIS[1] = VIS[1] + k;
+  VIS[2] = VIS[2] + 1.0;
+  if (ffg > LIMIT) return;
+  f2(x, ffg);
+  VIS[1] = VIS[1] + N;
+}
+
 //-----------------------------------------------------------------------------
 void Taquart::UsmtCore::POSTEP(int &METH, int &ITER, int &IND1) {
   //      SUBROUTINE POSTEP(METH,ITER,IND1)
@@ -5001,17 +6778,19 @@ void Taquart::UsmtCore::RENUM(double &TRY, double &VAL, int ix[], int &j1,
 }
 
 //-----------------------------------------------------------------------------
-void Taquart::UsmtCore::RDINP(Taquart::SMTInputData &InputData) {
+void Taquart::UsmtCore::RDINP(const Taquart::SMTInputView &InputData) {
+  GEOREADY = false;
+  NUTH = 0;
   N = InputData.Count();
+  CHANNELS(N);
   TROZ = InputData.GetRuptureTime();
-  Taquart::SMTInputLine InputLine;
   for (int i = 1; i <= N; i++) {
     //RPSTID[i] = i-1;
     //KNID[i] = i-1;
     //RPSTCP[i] = 'Z';
     //PS[i] = ' ';
-    InputData.Get(i - 1, InputLine);
-    U[i] = InputLine.Displacement;
+    const Taquart::SMTInputLine &InputLine = InputData.Line(i - 1);
+    U[i] = InputData.GetDisplacement(i - 1);
     //ARR[i] = InputLine.Incidence; /* TODO -o3.1.19 : Code for SV and SH is switched off by default. */
     AZM[i] = InputLine.Azimuth;
     TKF[i] = InputLine.TakeOff;
@@ -5022,6 +6801,143 @@ void Taquart::UsmtCore::RDINP(Taquart::SMTInputData &InputData) {
   }
 }
 
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::CHANNELS(int NC) {
+  // Per-channel arrays for NC stations. They never shrink, so a context
+  // reused for many inversions (noise and jackknife tests) allocates them
+  // once; newly allocated arrays are zeroed.
+  U.Reserve(NC);
+  AZM.Reserve(NC);
+  TKF.Reserve(NC);
+  GA.Reserve(NC);
+  A.Reserve(NC);
+  AT.Reserve(NC);
+  HT.Reserve(NC);
+  L1ORDER.Reserve(NC);
+  for (int j = 0; j <= 3; j++)
+    FIJ[j].Reserve(NC);
+  RO.Reserve(NC);
+  VEL.Reserve(NC);
+  R.Reserve(NC);
+  UTH.Reserve(NC);
+  for (int i = 0; i <= 6; i++)
+    PINV[i].Reserve(NC);
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtCore::GEOMET(void) {
+  // Station geometry of the inversion (ANGGA, JEZ, AMATRX and FIJGEN), or
+  // its copy from Geometry. ANGGA leaves GA as it is below
+  // MIN_ALLOWED_CHANNELS stations, so such networks are not cached.
+  if (Geometry && N >= MIN_ALLOWED_CHANNELS && Geometry->Find(*this)) {
+    GEOREADY = true;
+    return;
+  }
+  const bool OK = ANGGA();
+  JEZOK = JEZ();
+  AMATRX();
+  FIJGEN();
+  GEOREADY = true;
+  if (Geometry && OK) Geometry->Store(*this);
+}
+
+//-----------------------------------------------------------------------------
+Taquart::UsmtGeometryCache::UsmtGeometryCache(int ACapacity) {
+  Capacity = ACapacity;
+  Hits = 0;
+  Misses = 0;
+}
+
+//-----------------------------------------------------------------------------
+bool Taquart::UsmtGeometryCache::Match(const Entry &E,
+    const Taquart::UsmtCore &Core) {
+  const int N = Core.N;
+  if (int(E.KEY.size()) != 5 * N + 1) return false;
+  for (int i = 1; i <= N; i++)
+    if (E.KEY[i - 1] != Core.AZM[i] || E.KEY[N + i - 1] != Core.TKF[i]
+        || E.KEY[2 * N + i - 1] != Core.R[i]
+        || E.KEY[3 * N + i - 1] != Core.VEL[i]
+        || E.KEY[4 * N + i - 1] != Core.RO[i]) return false;
+  return E.KEY[5 * N] == Core.QF;
+}
+
+//-----------------------------------------------------------------------------
+bool Taquart::UsmtGeometryCache::Find(Taquart::UsmtCore &Core) {
+  bool FOUND = false;
+#pragma omp critical(UsmtGeometryCache)
+  {
+    std::list<Entry>::iterator E = Entries.begin();
+    while (E != Entries.end() && !Match(*E, Core))
+      ++E;
+    if (E != Entries.end()) {
+      Entries.splice(Entries.begin(), Entries, E);
+      for (int i = 1; i <= Core.N; i++) {
+        for (int j = 1; j <= 3; j++)
+          Core.GA[i][j] = E->GA[3 * (i - 1) + j - 1];
+        for (int j = 1; j <= 3; j++)
+          for (int k = 1; k <= 3; k++)
+            Core.FIJ[j][k][i] = E->FIJ[9 * (i - 1) + 3 * (j - 1) + k - 1];
+        for (int j = 1; j <= 6; j++)
+          Core.A[i][j] = E->A[6 * (i - 1) + j - 1];
+      }
+      // JEZ updates QSD only when it succeeds.
+      Core.JEZOK = E->JEZOK;
+      if (E->JEZOK) Core.QSD = E->QSD;
+      Hits++;
+      FOUND = true;
+    }
+    else
+      Misses++;
+  }
+  return FOUND;
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtGeometryCache::Store(const Taquart::UsmtCore &Core) {
+  const int N = Core.N;
+  Entry E;
+  E.KEY.resize(5 * N + 1);
+  E.GA.resize(3 * N);
+  E.FIJ.resize(9 * N);
+  E.A.resize(6 * N);
+  for (int i = 1; i <= N; i++) {
+    E.KEY[i - 1] = Core.AZM[i];
+    E.KEY[N + i - 1] = Core.TKF[i];
+    E.KEY[2 * N + i - 1] = Core.R[i];
+    E.KEY[3 * N + i - 1] = Core.VEL[i];
+    E.KEY[4 * N + i - 1] = Core.RO[i];
+    for (int j = 1; j <= 3; j++)
+      E.GA[3 * (i - 1) + j - 1] = Core.GA[i][j];
+    for (int j = 1; j <= 3; j++)
+      for (int k = 1; k <= 3; k++)
+        E.FIJ[9 * (i - 1) + 3 * (j - 1) + k - 1] = Core.FIJ[j][k][i];
+    for (int j = 1; j <= 6; j++)
+      E.A[6 * (i - 1) + j - 1] = Core.A[i][j];
+  }
+  E.KEY[5 * N] = Core.QF;
+  E.JEZOK = Core.JEZOK;
+  E.QSD = Core.QSD;
+
+#pragma omp critical(UsmtGeometryCache)
+  {
+    // Another context may have stored the same network meanwhile.
+    std::list<Entry>::iterator F = Entries.begin();
+    while (F != Entries.end() && !Match(*F, Core))
+      ++F;
+    if (F == Entries.end()) {
+      Entries.push_front(E);
+      while (int(Entries.size()) > Capacity && !Entries.empty())
+        Entries.pop_back();
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+void Taquart::UsmtGeometryCache::Clear(void) {
+#pragma omp critical(UsmtGeometryCache)
+  Entries.clear();
+}
+
 //-----------------------------------------------------------------------------
 void Taquart::UsmtCore::SIZEMM(int &IEXP) {
   double X = 0.0;
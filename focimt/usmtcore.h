@@ -34,7 +34,9 @@
 //-----------------------------------------------------------------------------
 
 #include <list>
+#include <vector>
 #include <math.h>
+#include <stdint.h>
 #include "inputdata.h"
 #include "faultsolution.h"
 
@@ -45,6 +47,7 @@
 //  object C++ language without any profound improvements.
 //
 //  rev.
+//   1.5.0 Global state moved into the reentrant Taquart::UsmtCore context.
 //   1.4.0 Removed some unnecessary variables.
 //   1.2.0 Conditional #define USMTCORE_DEBUG directive included to prevent
 //    the unnecessary standard debug output for Windows application.
@@ -59,6 +62,512 @@
 #include <iostream>
 #endif
 
+// Number of values per sample in the RMBatch array of the L2 batch.
+#define L2BATCH_STRIDE 12
+
+// Value stored by the caller in the progress variable of Run to cancel the
+// inversion. The core never overwrites a negative value.
+#define USMT_CANCEL -1
+
+// Smallest step [deg] of the strike/dip/rake grid (DCGridStep), about 1.5
+// million nodes.
+#define DCGRID_MIN_STEP 2.0
+
+namespace Taquart {
+  class UsmtGeometryCache;
+
+  //---------------------------------------------------------------------------
+  // ChannelBuffer, ChannelVector, ChannelMatrix, ChannelRows
+  //  Storage of the per-channel arrays of UsmtCore, sized to the number of
+  //  stations of the event instead of a fixed maximum. Each array is a single
+  //  block aligned to USMT_ALIGN bytes, indexed like the former fixed arrays:
+  //  ChannelVector X[I], ChannelMatrix X[I][J] (rows of M values per station)
+  //  and ChannelRows X[J][I] (M rows of stations, each padded to a multiple of
+  //  USMT_ALIGN bytes). Channels is the largest station index (1-based
+  //  arrays), Reserve only ever grows the array and zeroes it when it does.
+  //---------------------------------------------------------------------------
+#define USMT_ALIGN 64
+
+  template<class T> class ChannelBuffer {
+    public:
+      ChannelBuffer(void) {
+        RAW = 0;
+        DATA = 0;
+        SIZE = 0;
+      }
+
+      ChannelBuffer(const ChannelBuffer &Source) {
+        RAW = 0;
+        DATA = 0;
+        SIZE = 0;
+        Assign(Source);
+      }
+
+      ~ChannelBuffer(void) {
+        delete[] RAW;
+      }
+
+      ChannelBuffer & operator=(const ChannelBuffer &Source) {
+        if (this != &Source) Assign(Source);
+        return *this;
+      }
+
+      // Discards the contents, the new block is zeroed.
+      void Allocate(size_t ASize) {
+        delete[] RAW;
+        RAW = new char[ASize * sizeof(T) + USMT_ALIGN];
+        DATA = reinterpret_cast<T*>((reinterpret_cast<uintptr_t>(RAW)
+            + USMT_ALIGN - 1) & ~uintptr_t(USMT_ALIGN - 1));
+        SIZE = ASize;
+        for (size_t i = 0; i < SIZE; i++)
+          DATA[i] = T();
+      }
+
+      T * Data(void) const {
+        return DATA;
+      }
+
+      size_t Size(void) const {
+        return SIZE;
+      }
+
+    private:
+      char * RAW;
+      T * DATA;
+      size_t SIZE;
+
+      void Assign(const ChannelBuffer &Source) {
+        Allocate(Source.SIZE);
+        for (size_t i = 0; i < SIZE; i++)
+          DATA[i] = Source.DATA[i];
+      }
+  };
+
+  template<class T> class ChannelVector {
+    public:
+      explicit ChannelVector(int AChannels = 0) {
+        CHANNELS = -1;
+        Reserve(AChannels);
+      }
+
+      void Reserve(int AChannels) {
+        if (AChannels <= CHANNELS) return;
+        BUFFER.Allocate(AChannels + 1);
+        CHANNELS = AChannels;
+      }
+
+      operator T *(void) {
+        return BUFFER.Data();
+      }
+
+      operator const T *(void) const {
+        return BUFFER.Data();
+      }
+
+    private:
+      ChannelBuffer<T> BUFFER;
+      int CHANNELS;
+  };
+
+  template<class T, int M> class ChannelMatrix {
+    public:
+      typedef T Row[M];
+
+      explicit ChannelMatrix(int AChannels = 0) {
+        CHANNELS = -1;
+        Reserve(AChannels);
+      }
+
+      void Reserve(int AChannels) {
+        if (AChannels <= CHANNELS) return;
+        BUFFER.Allocate(size_t(AChannels + 1) * M);
+        CHANNELS = AChannels;
+      }
+
+      operator Row *(void) {
+        return reinterpret_cast<Row*>(BUFFER.Data());
+      }
+
+      operator const Row *(void) const {
+        return reinterpret_cast<const Row*>(BUFFER.Data());
+      }
+
+    private:
+      ChannelBuffer<T> BUFFER;
+      int CHANNELS;
+  };
+
+  template<class T, int M> class ChannelRows {
+    public:
+      explicit ChannelRows(int AChannels = 0) {
+        CHANNELS = -1;
+        STRIDE = 0;
+        Reserve(AChannels);
+      }
+
+      ChannelRows(const ChannelRows &Source) :
+          BUFFER(Source.BUFFER) {
+        CHANNELS = Source.CHANNELS;
+        STRIDE = Source.STRIDE;
+        Link();
+      }
+
+      ChannelRows & operator=(const ChannelRows &Source) {
+        BUFFER = Source.BUFFER;
+        CHANNELS = Source.CHANNELS;
+        STRIDE = Source.STRIDE;
+        Link();
+        return *this;
+      }
+
+      void Reserve(int AChannels) {
+        if (AChannels <= CHANNELS) return;
+        const size_t LINE = USMT_ALIGN / sizeof(T);
+        STRIDE = (size_t(AChannels + 1) + LINE - 1) / LINE * LINE;
+        BUFFER.Allocate(STRIDE * M);
+        CHANNELS = AChannels;
+        Link();
+      }
+
+      operator T * const *(void) {
+        return ROW;
+      }
+
+      operator const T * const *(void) const {
+        return CROW;
+      }
+
+    private:
+      ChannelBuffer<T> BUFFER;
+      int CHANNELS;
+      size_t STRIDE;
+      T * ROW[M];
+      const T * CROW[M];
+
+      void Link(void) {
+        for (int j = 0; j < M; j++) {
+          ROW[j] = BUFFER.Data() + j * STRIDE;
+          CROW[j] = ROW[j];
+        }
+      }
+  };
+
+  //---------------------------------------------------------------------------
+  // UsmtCore
+  //  Solver context of the moment tensor inversion. Every former global of the
+  //  USMT core (input data, design matrix, solutions and work arrays) is now a
+  //  member of the context, so independent inversions can run concurrently as
+  //  long as each of them uses its own UsmtCore object.
+  //---------------------------------------------------------------------------
+  class UsmtCore {
+    public:
+      UsmtCore(void);
+
+      // Inversion of the lines of InputData with the PickActive and
+      // ChannelActive flags set.
+      void Run(Taquart::NormType ANormType, int QualityType,
+          Taquart::SMTInputData &InputData, int * const AThreadProgress);
+
+      // Inversion of the active channels of a view (see SMTInputView), used
+      // by the jackknife and noise tests to avoid copying the input data.
+      void Run(Taquart::NormType ANormType, int QualityType,
+          const Taquart::SMTInputView &InputData,
+          int * const AThreadProgress);
+
+      void TransferSolution(Taquart::SolutionType AType,
+          std::list<Taquart::FaultSolution> &ASolution);
+
+      void TransferSolution(Taquart::SolutionType AType,
+          Taquart::FaultSolution &ASolution);
+
+      // Theoretical amplitudes of the stations predicted by the full solution
+      // of the last L2, Lp or Huber inversion (none after an L1 inversion).
+      // They are the same for all solution types, so they are kept apart
+      // from FaultSolution and copied only on request.
+      void TransferAmplitudes(std::vector<double> &UTh) const;
+
+      // Batched L2 inversion of many amplitude vectors measured on the same
+      // stations (e.g. the amplitude noise test). PrepareL2Batch builds the
+      // design matrix and the pseudo-inverses once, SolveL2Batch applies them
+      // to all amplitude vectors at once and RunL2Batch completes the
+      // inversion of a single sample (the context may be a copy of the one
+      // used by PrepareL2Batch).
+      void PrepareL2Batch(const Taquart::SMTInputView &InputData);
+      void SolveL2Batch(const double UBatch[], double RMBatch[], int Count);
+      void RunL2Batch(int QualityType, const double USample[],
+          const double RMSample[], int * const AThreadProgress);
+
+      // L2 jackknife: inversion without the Channel-th station (1-based) of
+      // the context Full, prepared with PrepareL2Batch. The normal matrices
+      // of Full are downdated instead of being inverted again.
+      void RunL2Jackknife(const Taquart::UsmtCore &Full, int Channel,
+          int QualityType, int * const AThreadProgress);
+
+      // Station geometry cache used by Run and PrepareL2Batch (none by
+      // default), see UsmtGeometryCache.
+      Taquart::UsmtGeometryCache * Geometry;
+
+      // Number of threads sharing every level of the L1 grid searches of a
+      // single inversion (1 by default). The result does not depend on it.
+      int GridThreads;
+
+      // L1 misfit SUM|A*M-U| of the full (1) and trace-null (2) solutions and
+      // the time in seconds spent on both of them by the last L1 inversion.
+      double L1Misfit[2 + 1];
+      double L1Time;
+
+      // True if the full (1) or trace-null (2) solution of the last L1
+      // inversion was found by linear programming (ntL1X), false if it was
+      // found by the grid search, also as the fallback of ntL1X.
+      bool L1Exact[2 + 1];
+
+      // Warm start of the L1 grid searches (off by default). The initial boxes
+      // are built around the full (GSOL) or trace-null (GSOL5, GSOLA) solution
+      // instead of spanning +-10**IEXP, see L1BOX. A search stops once every side of its box is
+      // narrower than L1Tolerance times the largest moment tensor component
+      // (0 runs all 50 levels).
+      bool L1WarmStart;
+      double L1Tolerance;
+
+      // Levels and grid points visited by the L1 grid searches of the last
+      // inversion (1) and those of the original 50-level searches (2).
+      int L1Levels[2 + 1];
+      double L1Points[2 + 1];
+
+      // Branch and bound mode of GSOL and GSOL5 (off by default). Subtrees of
+      // the grid whose misfit bound exceeds the best misfit are skipped, the
+      // solution is the same. L1Pruned holds the grid points skipped (1) out
+      // of those of both searches (2) in the last inversion.
+      bool L1Prune;
+      double L1Pruned[2 + 1];
+
+      // Early exit of the L1 objective (off by default). The misfit of a
+      // grid point is summed over the channels in the order of decreasing |U|
+      // and abandoned once it exceeds the best misfit, the solution is the
+      // same. L1Visits holds the channels visited (1) and the evaluations (2)
+      // of the grid searches in the last inversion.
+      bool L1Abandon;
+      double L1Visits[2 + 1];
+
+      // Parameters of the ntLp and ntHuber norms: the exponent p (1<=p<=2,
+      // 1.5 by default) and the Huber threshold in units of the robust
+      // standard deviation of the L2 residuals (1.345 by default).
+      double LpExponent;
+      double HuberConstant;
+
+      // Time budget of Run in milliseconds (0, the default, means none). When
+      // it expires, or when the caller stores USMT_CANCEL in the progress
+      // variable, the L1 grid searches return the best solution found so far
+      // (every search completes at least its first level). HaltReason is then
+      // 1 (deadline) or 2 (cancelled), HaltSearch the search that stopped
+      // first (1 GSOL, 2 GSOL5, 3 GSOLA), HaltLevel the levels it completed
+      // and HaltWidth the largest side of its box.
+      double DeadlineMs;
+      int HaltReason;
+      int HaltSearch;
+      int HaltLevel;
+      double HaltWidth;
+
+      // Closed-form eigenvalues in EIG3 and eigenvectors in XTRINF instead of
+      // the bisection of the characteristic equation (off by default).
+      bool ClosedFormEigen;
+
+      // Levenberg-Marquardt fit of the double-couple solution of the L2, Lp
+      // and Huber norms to the amplitudes (DCLM) instead of the fixed-point
+      // refinement of its axes in BETTER (off by default). Either way the
+      // iterations and the convergence are stored in the double-couple
+      // FaultSolution.
+      bool LMDoubleCouple;
+
+      // Strike/dip/rake grid search for the double-couple solution instead of
+      // BETTER and GSOLA (off while DCGridStep, in degrees, is 0). Strike and
+      // rake (from -180) cover 360 degrees and dip 0-90 degrees in
+      // DCGridSize(1..3) steps of about DCGridStep. The misfit of every node,
+      // with the scalar moment fitted in the L1 norm for ntL1 and ntL1X and
+      // in the L2 norm otherwise and relative to that of a zero moment, is
+      // kept in DCSurface (index (IS*ND+ID)*NR+IR from 0), and the strike,
+      // dip, rake and misfit of the optimum in DCBest(1..4). Steps below
+      // DCGRID_MIN_STEP are raised to it.
+      double DCGridStep;
+      int DCGridSize[3 + 1];
+      std::vector<double> DCSurface;
+      double DCBest[4 + 1];
+
+      // Nodal-plane uncertainty region of the last grid search: the number
+      // of nodes whose misfit exceeds that of the optimum by at most
+      // Tolerance times the misfit range (largest minus smallest) of
+      // DCSurface, and in Angle the largest angle in degrees between their
+      // tensors and that of the optimum.
+      int DCRegion(double Tolerance, double &Angle) const;
+
+      // Accuracy and speed of EIG3 with both solvers on Count random tensors
+      // (general, uniaxial and double-couple ones). Time(1) and Time(2) are
+      // the mean times per call in seconds of the bisection and of the
+      // closed-form solver, MaxError the largest difference of their
+      // eigenvalues relative to the largest eigenvalue and MaxTrace the
+      // largest relative trace residual of the closed-form solver.
+      void BenchmarkEigen(int Count, double Time[], double &MaxError,
+          double &MaxTrace);
+
+      static const int NDAE[10];
+      //char PS[MAXCHANNEL+1];
+      Taquart::ChannelVector<double> U;
+      //double ARR[MAXCHANNEL+1];
+      Taquart::ChannelVector<double> AZM;
+      Taquart::ChannelVector<double> TKF;
+      Taquart::ChannelMatrix<double, 3 + 1> GA;
+      Taquart::ChannelMatrix<double, 6 + 1> A;
+      Taquart::ChannelRows<double, 6 + 1> AT; /*!< Columns of A (L1 kernels). */
+      Taquart::ChannelRows<double, 5 + 1> HT; /*!< Trace-null columns of A. */
+      Taquart::ChannelVector<int> L1ORDER; /*!< Channels by decreasing |U|. */
+      Taquart::ChannelRows<double, 3 + 1> FIJ[3 + 1];
+      double RM[6 + 1][3 + 1];
+      double COV[6 + 1][6 + 1][3 + 1];
+      Taquart::ChannelVector<int> RO;
+      Taquart::ChannelVector<int> VEL;
+      Taquart::ChannelVector<int> R;
+      Taquart::ChannelVector<double> UTH;
+      double DAE[212 + 1][3 + 1]; /*!< Sphere sampling table used by JEZ. */
+      Taquart::ChannelMatrix<double, 2 + 1> PINV[6 + 1]; /*!< L2 pseudo-inverses. */
+      double NINV[6 + 1][6 + 1][2 + 1]; /*!< Inverted L2 normal matrices. */
+      int N;
+      double TROZ;
+      double QSD;
+      double QF;
+      bool FSTCLL;
+      int ICOND;
+      bool GEOREADY; /*!< GA, FIJ and A (of MOM2) match the stations. */
+      bool JEZOK; /*!< Result of the last JEZ (QSD updated). */
+      int DCITER; /*!< Iterations of BETTER or DCLM. */
+      int NUTH; /*!< Number of stations in UTH (0 if not computed). */
+      Taquart::FaultSolution Solution[4];
+      //int RPSTID[MAXCHANNEL+1];
+      //int KNID[MAXCHANNEL+1];
+      //int ACTIV[MAXCHANNEL+1];
+      //char RPSTCP[MAXCHANNEL+1];
+      int ISTA;
+      int * ThreadProgress;
+      double StartTime;
+
+      //struct nodal_plane { double str;  double dip;  double rake; };
+      //double zero_360(double str);
+      //DLL_EXP double computed_rake1(nodal_plane NP1);
+      //double computed_rake2(double str1,double dip1,double str2,double dip2,double fault);
+      //DLL_EXP double computed_dip1(nodal_plane NP1);
+      //DLL_EXP double computed_strike1(nodal_plane NP1);
+      //void sincos(double a, double *s, double *c);
+
+      void PROGRESS(double Progress, double Max);
+      bool ANGGA(void);
+      bool JEZ(void);
+      void MOM1(int &IEXP, int QualityType, bool EXACT = false);
+      void GSOL(double x[], int &iexp);
+      void L1BOX(int NP, const int MAP[], int K, double xlo[],
+          double xhi[]);
+      void L1START(void);
+      bool L1STOP(int NP, const double xlo[], const double xhi[]);
+      double L1SCALE(void);
+      bool L1HALT(int SEARCH, int LEVEL, int NP, const double xlo[],
+          const double xhi[]);
+      void f1(double X[], double &fff);
+      void f1(const double PART[], const double COL[], double &fff);
+      void f1(const double PART[], const double COL[], double &fff,
+          double val, double VIS[]);
+      void L1MATRX(void);
+      bool L1LP(int NP, const double * const AM[], double X[]);
+      bool L1LPSOLVE(double M[][6 + 1], double b[], int n);
+      void L1LPSORT(double T[], int IDX[], int n);
+      void EIG3(double RM[], int ISTER, double E[]);
+      void EIG3CF(const double Q[], double E[]);
+      void EIGVCF(const double Q[], double EV, double V[]);
+      void EIGGEN(double &E1, double &E2, double &E3, double &ALFA,
+          double &BETA, double &GAMA);
+      void EIGGEN_NEW(double e1, double e2, double e3, double &iso,
+          double &clvd, double &dbcp);
+      void GSOL5(double x[], int &IEXP);
+      void GSOLA(double x[], int &IEXP);
+      bool GSOLAS(int K, int IEXP, double xtry[], double xmem[], double &vmem,
+          int &levels, double VIS[], bool Report);
+      void GSOLAB(int K, int j1, int j2, const double xlo[],
+          const double xstep[], double xtry[], double &val, int ix[],
+          double x[], double VIS[]);
+      void XTRINF(int &ICOND, int LNORM, double Moment0[], double MomentErr[]);
+      void f2(double x[], double &ffg);
+      void f2(double x[], double &ffg, double val, double VIS[]);
+      void POSTEP(int &METH, int &ITER, int &IND1);
+      double DETR(double T[], double X);
+      void RENUM(double &TRY, double &VAL, int ix[], int &j1, int &j2, int &j3,
+          int &j4);
+      void RDINP(const Taquart::SMTInputView &InputData);
+      void CHANNELS(int NC);
+      void GEOMET(void);
+      void SIZEMM(int &IEXP);
+      void MOM2(bool REALLY, int QualityType, bool PRESOLVED = false);
+      void AMATRX(void);
+      void PSINV(void);
+      void IRLS(Taquart::NormType ANormType);
+      void INVMAT(double A[][10], double B[][10], int NP);
+      void FIJGEN(void);
+      void BETTER(double &RMY, double &RMZ, double &RM0, double &RMT,
+          int &ICOND);
+      bool DCLM(const double VT[], const double VP[], double &RM0, int &ICOND);
+      void GRIDDC(int LNORM, double SCALE, double &RM0);
+
+      void LUBKSB2(double A[][10], int INDX[], double C[][10], double B[][10],
+          int &NP, int jj);
+      void LUDCMP(double B[][10], double A[][10], int INDX[], double &D,
+          int &NP);
+      void VEIG(double &s1, double &s2, double &s3, double &s4, double &s5,
+          double &s6, double v[]);
+      void ORT(double VE[], double VN[], double DE[], double DN[]);
+      void Zero(double * Address, int C);
+  };
+
+  //---------------------------------------------------------------------------
+  // UsmtGeometryCache
+  //  Station geometry shared by the inversions of the same network. GA, FIJ,
+  //  the design matrix A of MOM2 and the coverage factor QSD of JEZ depend on
+  //  the azimuths, take-off angles, distances, velocities and densities of
+  //  the stations only. UsmtCore::Run and UsmtCore::PrepareL2Batch copy them
+  //  from the cache when it holds the same stations, in the same order, and
+  //  store them there otherwise. Beyond Capacity networks the least recently
+  //  used one is dropped. One cache may serve the contexts of all threads.
+  //---------------------------------------------------------------------------
+  class UsmtGeometryCache {
+    public:
+      UsmtGeometryCache(int ACapacity = 64);
+
+      // Copies the geometry of the stations of Core into it; false if the
+      // cache does not hold them.
+      bool Find(Taquart::UsmtCore &Core);
+
+      // Adds the geometry computed by Core.
+      void Store(const Taquart::UsmtCore &Core);
+
+      void Clear(void);
+
+      int Capacity;
+      int Hits;
+      int Misses;
+
+    private:
+      struct Entry {
+          std::vector<double> KEY; /*!< AZM, TKF, R, VEL, RO of all stations and QF. */
+          std::vector<double> GA;
+          std::vector<double> FIJ;
+          std::vector<double> A;
+          bool JEZOK;
+          double QSD;
+      };
+      std::list<Entry> Entries; /*!< The most recently used first. */
+
+      static bool Match(const Entry &E, const Taquart::UsmtCore &Core);
+  };
+}
+
+// The functions below run on a single, shared UsmtCore context and are kept
+// for the existing callers. They are not reentrant; use a separate
+// Taquart::UsmtCore object per thread instead.
 void USMTCore(Taquart::NormType ANormType, int QualityType,
     Taquart::SMTInputData &InputData, int * const AThreadProgress);
 
@@ -68,80 +577,5 @@ void TransferSolution(Taquart::SolutionType AType,
 void TransferSolution(Taquart::SolutionType AType,
     Taquart::FaultSolution &ASolution);
 
-namespace Taquart {
-  namespace UsmtCore {
-    extern int NDAE[10];
-    //extern char PS[MAXCHANNEL+1];
-    extern double U[MAXCHANNEL + 1];
-    //extern double ARR[MAXCHANNEL+1];
-    extern double AZM[MAXCHANNEL + 1];
-    extern double TKF[MAXCHANNEL + 1];
-    extern double GA[MAXCHANNEL + 1][3 + 1];
-    extern double A[MAXCHANNEL + 1][6 + 1];
-    extern double FIJ[3 + 1][3 + 1][MAXCHANNEL + 1];
-    extern double RM[6 + 1][3 + 1];
-    extern double COV[6 + 1][6 + 1][3 + 1];
-    extern int RO[MAXCHANNEL + 1];
-    extern int VEL[MAXCHANNEL + 1];
-    extern int R[MAXCHANNEL + 1];
-    extern double UTH[MAXCHANNEL + 1];
-    extern int N;
-    extern double TROZ;
-    extern double QSD;
-    extern double QF;
-    extern bool FSTCLL;
-    extern int ICOND;
-    extern Taquart::FaultSolution Solution[4];
-    //extern int RPSTID[MAXCHANNEL+1];
-    //extern int KNID[MAXCHANNEL+1];
-    //extern int ACTIV[MAXCHANNEL+1];
-    //extern char RPSTCP[MAXCHANNEL+1];
-    extern int ISTA;
-    extern int * ThreadProgress;
-
-    //struct nodal_plane { double str;  double dip;  double rake; };
-    //double zero_360(double str);
-    //DLL_EXP double computed_rake1(nodal_plane NP1);
-    //double computed_rake2(double str1,double dip1,double str2,double dip2,double fault);
-    //DLL_EXP double computed_dip1(nodal_plane NP1);
-    //DLL_EXP double computed_strike1(nodal_plane NP1);
-    //void sincos(double a, double *s, double *c);
-
-    void PROGRESS(double Progress, double Max);
-    bool ANGGA(void);
-    bool JEZ(void);
-    void MOM1(int &IEXP, int QualityType);
-    void GSOL(double x[], int &iexp);
-    void f1(double X[], double &fff);
-    void EIG3(double RM[], int ISTER, double E[]);
-    void EIGGEN(double &E1, double &E2, double &E3, double &ALFA, double &BETA,
-        double &GAMA);
-    void EIGGEN_NEW(double e1, double e2, double e3, double &iso, double &clvd,
-        double &dbcp);
-    void GSOL5(double x[], int &IEXP);
-    void GSOLA(double x[], int &IEXP);
-    void XTRINF(int &ICOND, int LNORM, double Moment0[], double MomentErr[]);
-    void f2(double x[], double &ffg);
-    void POSTEP(int &METH, int &ITER, int &IND1);
-    double DETR(double T[], double X);
-    void RENUM(double &TRY, double &VAL, int ix[], int &j1, int &j2, int &j3,
-        int &j4);
-    void RDINP(Taquart::SMTInputData &InputData);
-    void SIZEMM(int &IEXP);
-    void MOM2(bool REALLY, int QualityType);
-    void INVMAT(double A[][10], double B[][10], int NP);
-    void FIJGEN(void);
-    void BETTER(double &RMY, double &RMZ, double &RM0, double &RMT, int &ICOND);
-
-    void LUBKSB2(double A[][10], int INDX[], double C[][10], double B[][10],
-        int &NP, int jj);
-    void LUDCMP(double B[][10], double A[][10], int INDX[], double &D, int &NP);
-    void VEIG(double &s1, double &s2, double &s3, double &s4, double &s5,
-        double &s6, double v[]);
-    void ORT(double VE[], double VN[], double DE[], double DN[]);
-    void Zero(double * Address, int C);
-  }
-}
-
 //---------------------------------------------------------------------------
 #endif